@@ -51,10 +51,28 @@
  *                          recommended to sample all channels (set descriptor
  *                          entry 'SAMPLE_ALL=1'. Otherwise the interrupt rate
  *                          will be very high.
+ *                          Alternatively the adaptive interrupt moderation
+ *                          (IRQ_MOD/MODE=1) can be used: above a scan rate
+ *                          threshold, the enabled channels are sampled
+ *                          several times per measurement cycle, so each
+ *                          interrupt delivers a batch of scans.
+ *                          For slow signals, the software-timed sampling
+ *                          (SW_TIMER/PERIOD) reads the data registers from
+ *                          a periodic timer with the interrupt disabled.
  *
  *               The buffering method depends on the block read i/o mode, which
  *               can be defined via M_BUF_RD_MODE setstat (1).
  *
+ *               The driver does its own locking (LL_LOCK_NONE): block reads
+ *               and input buffer status codes are serialized by the read
+ *               lock, which is released while a reader waits for data.
+ *               Configuration and flash/EEPROM access are serialized by the
+ *               config lock. All other status calls (statistics, levels,
+ *               snapshot, ext. pin) take no lock and return immediately,
+ *               also while a reader is blocked. Only M36_Read and
+ *               M36_BLK_SNAPSHOT without acquisition read the data
+ *               registers with the config lock held.
+ *
  *               (1) = defineable via status call
  *               (2) = defineable via descriptor key
  *
@@ -137,6 +155,18 @@ static const char RCSid[]="$Id: m36_drv.c,v 1.11 2010/09/21 17:47:59 ts Exp $";
 #define CH_NUMBER_SINGLE	16	/* nr of device channels (single ended mode) */
 #define CH_NUMBER_DIFF		8	/* nr of device channels (differential mode) */
 #define CH_BYTES			2		/* nr of bytes per channel */
+#define FRAME_MAX_ALIGN		32		/* max. frame alignment [bytes] */
+#define FRAME_HDR_WORDS		(sizeof(M36_FRAME_HDR) / CH_BYTES)
+#define FRAME_MAX_WORDS		(FRAME_HDR_WORDS + CH_NUMBER_SINGLE + \
+							 FRAME_MAX_ALIGN / CH_BYTES) /* max. frame size
+															[words] */
+#define DFR_SLOT_WORDS		(FRAME_HDR_WORDS + CH_NUMBER_SINGLE)
+											/* deferred ring slot:
+											   header + raw scan */
+#define RING_SLOT_WORDS		DFR_SLOT_WORDS	/* scan ring slot */
+#define TRG_SLOT_WORDS		DFR_SLOT_WORDS	/* trigger history slot */
+#define TRG_PRE_MAX			256		/* max. pre-trigger scans (per irq) */
+#define SW_SYNC_USEC		1000	/* max. wait for scan end (SW_TIMER) */
 #define USE_IRQ				TRUE	/* interrupt required  */
 #define ADDRSPACE_COUNT		1		/* nr of required address spaces */
 #define ADDRSPACE_SIZE		256		/* size of address space */
@@ -185,6 +215,77 @@ static const char RCSid[]="$Id: m36_drv.c,v 1.11 2010/09/21 17:47:59 ts Exp $";
 #define bitclr(byte,mask)		((byte) &= ~(mask))
 #define bitmove(byte,mask,bit)	(bit ? bitset(byte,mask) : bitclr(byte,mask))
 
+/* sample as signed (bipolar) or unsigned (unipolar) value */
+#define TRG_VALUE(llHdl,raw)	((llHdl)->bipolar ? (int32)(int16)(raw) : \
+								 (int32)(u_int16)(raw))
+
+/* scans are stored with frame header (scan ring or FRAME_HEADER=1) */
+#define HDR_STORED(llHdl)		((llHdl)->ringDepth || \
+								 ((llHdl)->hdrWords && !(llHdl)->demuxDepth))
+
+/* max. scans per interrupt for nbr enabled channels (IRQ_MOD) */
+#define BATCH_MAX(llHdl,nbr)	(((llHdl)->sampleAll || (llHdl)->binSample || \
+								  ((nbr) == 0)) ? 1 : CH_NUMBER_SINGLE / (nbr))
+
+/*
+ * Frame header timestamp: OSS ticks by default (resolution 1/tickRate),
+ * the CPU cycle counter with IN_BUF/STAMP_CLOCK=1 where the compiler
+ * provides one. M36_TIMESTAMP may also be overridden via the makefile.
+ */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+# define M36_CYCLES()			((u_int32)__builtin_ia32_rdtsc())
+#endif
+
+#ifndef M36_TIMESTAMP
+# ifdef M36_CYCLES
+#  define M36_TIMESTAMP(llHdl)	((llHdl)->stampClock ? M36_CYCLES() : \
+								 OSS_TickGet((llHdl)->osHdl))
+# else
+#  define M36_TIMESTAMP(llHdl)	OSS_TickGet((llHdl)->osHdl)
+# endif
+#endif
+
+/*
+ * Memory barrier between ring slot data and ring index update (deferred
+ * ring, scan ring, buffer queue, channel rings, snapshot sequence lock).
+ * The indices are volatile, the barrier orders the slot accesses. For
+ * other compilers, define M36_MEMBAR() in the makefile, e.g.
+ * -D'M36_MEMBAR()=KeMemoryBarrier()'.
+ */
+#ifndef M36_MEMBAR
+# ifdef __GNUC__
+#  define M36_MEMBAR()			__sync_synchronize()
+# else
+#  error "M36_MEMBAR: no memory barrier known for this compiler"
+# endif
+#endif
+
+/*
+ * Shadowed register writes: the last value written to CTRL_REG, ADR_REG(i)
+ * and CFG_REG(i) is kept in the ll handle, so registers are never read back
+ * (no read-modify-write cycles) and unchanged ADR/CFG values are not written.
+ * RST and CAL are trigger bits and never stored in the shadow.
+ */
+#define SHADOW_INVALID		0xffff		/* no valid ADR/CFG value */
+
+#define CTRL_WRITE(llHdl,val) \
+	{ (llHdl)->ctrlShadow = (u_int16)(val); \
+	  MWRITE_D16((llHdl)->ma, CTRL_REG, (llHdl)->ctrlShadow); }
+
+#define ADR_WRITE(llHdl,i,val) \
+	{ if ((llHdl)->adrShadow[i] != (u_int16)(val)) { \
+		(llHdl)->adrShadow[i] = (u_int16)(val); \
+		MWRITE_D16((llHdl)->ma, ADR_REG(i), (llHdl)->adrShadow[i]); } }
+
+#define CFG_WRITE(llHdl,i,val) \
+	{ if ((llHdl)->cfgShadow[i] != (u_int16)(val)) { \
+		(llHdl)->cfgShadow[i] = (u_int16)(val); \
+		MWRITE_D16((llHdl)->ma, CFG_REG(i), (llHdl)->cfgShadow[i]); } }
+
+/* config register value of a channel */
+#define CHAN_CFG(llHdl,ch)	((u_int16)(((llHdl)->bipolar  << 7) | \
+									   ((llHdl)->gain[ch] << 4) | (ch)))
+
 /* helpers for M36N Flash Access */
 #define HIWD(V) 	((V & 0xffff0000)>>16)
 #define LOWD(V) 	( V & 0x0000ffff)
@@ -248,7 +349,7 @@ static const char RCSid[]="$Id: m36_drv.c,v 1.11 2010/09/21 17:47:59 ts Exp $";
 |  TYPEDEFS                                |
 +-----------------------------------------*/
 /* ll handle */
-typedef struct {
+typedef struct _LL_HANDLE {
 	/* general */
     MACCESS         	ma;             /* hw access handle */
     int32           	memAlloc;		/* size allocated for the handle */
@@ -271,6 +372,157 @@ typedef struct {
 	u_int32				sampleAll;		/* sample all channels */
 	/* buffers */
     MBUF_HANDLE     	*bufHdl;		/* input buffer handle */
+	u_int32				bufSize;		/* input buffer size [bytes] */
+	u_int32				frameAlign;		/* frame alignment [bytes] (0=off) */
+	int32				frameWords;		/* frame size in buffer [words] */
+	u_int32				frameHdr;		/* frame header enabled */
+	u_int32				stampClock;		/* 0=OSS ticks, 1=CPU cycles */
+	int32				hdrWords;		/* frame header size [words] */
+	u_int32				scanSeq;		/* scan sequence number */
+	u_int32				irqStamp;		/* timestamp of current irq */
+	u_int16				chMask;			/* enabled channels bitmask */
+	u_int16				cfgGen;			/* configuration generation */
+
+	/* deferred irq processing (IRQ_DEFER) */
+	u_int32				dfrEnable;		/* top/bottom half split enabled */
+	u_int32				dfrPeriod;		/* bottom half timer period [ms] */
+	u_int16				*dfrRing;		/* raw scan ring (SPSC) */
+	u_int32				dfrRingSize;	/* allocated ring size [bytes] */
+	u_int32				dfrMask;		/* ring depth - 1 */
+	volatile u_int32	dfrHead;		/* next slot to write (top half) */
+	volatile u_int32	dfrTail;		/* next slot to read (bottom half) */
+	u_int32				dfrLost;		/* scans lost, ring full */
+	OSS_TIMER_HANDLE	*dfrTimer;		/* bottom half timer */
+
+	/* acquisition statistics (M36_BLK_STATS) */
+	u_int32				statScans;		/* scans stored into input buffer */
+	u_int32				statDropped;	/* scans lost, buffer full/ch set */
+	u_int32				statWrapFail;	/* frames truncated at wrap around */
+	u_int32				bufLevel;		/* input buffer fill level [bytes] */
+	u_int32				bufLevelMax;	/* fill level high-watermark [bytes] */
+	u_int32				irqTimeMax;		/* longest M36_Irq duration */
+
+	/* driver scan ring (SCAN_RING) */
+	u_int16				*ring;			/* slots: header + raw scan */
+	u_int32				ringSize;		/* allocated ring size [bytes] */
+	u_int32				ringDepth;		/* nbr of slots (0=off) */
+	u_int32				ringMask;		/* ring depth - 1 */
+	volatile u_int32	ringHead;		/* next slot to write (M36_Irq) */
+	u_int32				ringReaders;	/* nbr of read cursors */
+	u_int32				ringWait;		/* scans to wait for per read */
+	int32				ringTout;		/* wait timeout [msec] */
+	/* read cursors, selected by channel */
+	volatile u_int32	ringTail[CH_NUMBER_SINGLE];	/* next slot to read */
+	u_int32				ringLost[CH_NUMBER_SINGLE];	/* scans lost */
+	u_int32				ringHighwater[CH_NUMBER_SINGLE]; /* max. level */
+	u_int32				ringWaitN[CH_NUMBER_SINGLE];	/* reader waits */
+	OSS_SEM_HANDLE		*ringSem[CH_NUMBER_SINGLE];	/* reader wakeup */
+	/* adaptive wakeup batch (SCAN_RING/WAIT_MODE=1) */
+	u_int32				ringAdapt;		/* adaptive mode */
+	u_int32				ringLatency;	/* target latency [msec] */
+	u_int32				ringBatch[CH_NUMBER_SINGLE];	/* scans per wakeup */
+	u_int32				ringRate[CH_NUMBER_SINGLE];		/* scans/s */
+	u_int32				ringRateHead[CH_NUMBER_SINGLE];	/* head at ... */
+	u_int32				ringRateTick[CH_NUMBER_SINGLE];	/* ... tick */
+	OSS_SEM_HANDLE		*rdSemHdl;		/* read lock (released on wait) */
+	OSS_SEM_HANDLE		*cfgSemHdl;		/* config lock */
+
+	/* software trigger capture windows (TRIGGER) */
+	u_int32				trgEnable;		/* capture windows only */
+	u_int32				trgPre;			/* pre-trigger scans (M) */
+	u_int32				trgPost;		/* post-trigger scans (K) */
+	u_int32				trgCh;			/* trigger channel */
+	u_int32				trgLevel;		/* trigger level (raw value) */
+	u_int32				trgEdge;		/* condition (M36_TRG_xxx) */
+	u_int16				*trgHist;		/* history: header + raw scan */
+	u_int32				trgHistSize;	/* allocated size [bytes] */
+	u_int32				trgMask;		/* history depth - 1 */
+	u_int32				trgHistHead;	/* next slot to write */
+	u_int32				trgHistCnt;		/* valid slots (max. M+1) */
+	u_int32				trgLeft;		/* post-trigger scans to store */
+	u_int32				trgGen;			/* config gen of history */
+	int32				trgPrev;		/* previous trigger ch value */
+	u_int32				trgPrevOk;		/* trgPrev valid */
+	u_int32				trgWindows;		/* windows delivered */
+
+	/* gating by binary input (GATE/MODE) */
+	u_int32				gateMode;		/* M36_GATE_xxx */
+	u_int32				gateOpen;		/* gate open at last irq */
+	u_int32				gateStart;		/* next stored scan opens window */
+	u_int32				gateEdges;		/* gate edges seen */
+
+	/* binary input co-sampled into the frame header (BIN_SAMPLE) */
+	u_int32				binSample;		/* enabled */
+	u_int16				irqFlags;		/* header flags of current irq */
+
+	/* software-timed sampling (SW_TIMER/PERIOD) */
+	OSS_TIMER_HANDLE	*swTimer;		/* sampling timer */
+	u_int32				swPeriod;		/* timer period [msec] (0=stopped) */
+
+	/* finite acquisition (M36_ACQ_COUNT) */
+	u_int32				acqCount;		/* scans to acquire (0=off) */
+	volatile u_int32	acqLeft;		/* scans still to acquire */
+	OSS_SIG_HANDLE		*acqSig;		/* completion signal */
+
+	/* deadline bounded read (M36_BLK_READ) from input buffer */
+	volatile u_int32	dlWaitBytes;	/* reader waits for n bytes */
+	OSS_SEM_HANDLE		*dlSem;			/* reader wakeup */
+
+	/* buffer queue (BUF_QUEUE) */
+	u_int16				*bufq;			/* buffers: M36_BUFQ_HDR + data */
+	u_int32				bufqAlloc;		/* allocated size [bytes] */
+	u_int32				bufqNum;		/* nbr of buffers (0=off) */
+	u_int32				bufqMask;		/* nbr of buffers - 1 */
+	u_int32				bufqSize;		/* data size per buffer [bytes] */
+	u_int32				bufqStride;		/* buffer distance [words] */
+	volatile u_int32	bufqHead;		/* buffers completed (M36_Irq) */
+	volatile u_int32	bufqTail;		/* buffers dequeued (reader) */
+	u_int32				bufqLost;		/* scans lost, no free buffer */
+	int32				bufqTout;		/* dequeue timeout [msec] */
+	u_int32				bufqWaiting;	/* reader waits for a buffer */
+	OSS_SEM_HANDLE		*bufqSem;		/* reader wakeup */
+
+	/* demultiplexed channel rings (DEMUX) */
+	u_int16				*demux;			/* sample rings, one per channel */
+	u_int32				demuxAlloc;		/* allocated size [bytes] */
+	u_int32				demuxDepth;		/* samples per ring (0=off) */
+	u_int32				demuxMask;		/* ring depth - 1 */
+	int32				demuxTout;		/* read timeout [msec] */
+	volatile u_int32	demuxHead[CH_NUMBER_SINGLE];	/* M36_Irq */
+	volatile u_int32	demuxTail[CH_NUMBER_SINGLE];	/* reader */
+	u_int32				demuxLost[CH_NUMBER_SINGLE];	/* ring full */
+	u_int32				demuxWaitN[CH_NUMBER_SINGLE];	/* reader waits */
+	OSS_SEM_HANDLE		*demuxSem[CH_NUMBER_SINGLE];	/* reader wakeup */
+
+	/* staged channel configuration (M36_CFG_STAGE) */
+	u_int32				cfgStage;		/* setstats go to staged config */
+	volatile u_int32	cfgCommit;		/* commit pending (M36_Irq) */
+	u_int32				irqEnabled;		/* M_MK_IRQ_ENABLE state */
+	u_int32				stgEnable[CH_NUMBER_SINGLE];	/* staged enable */
+	u_int32				stgGain[CH_NUMBER_SINGLE];		/* staged gain */
+	u_int32				stgBipolar;		/* staged measuring mode */
+	u_int32				stgExtTrig;		/* staged trigger mode */
+
+	/* adaptive irq moderation (IRQ_MOD) */
+	u_int32				modMode;		/* 0=off, 1=adaptive */
+	u_int32				batch;			/* scans per interrupt */
+	u_int32				batchMax;		/* max. scans per interrupt */
+	u_int32				scanSkip;		/* nbr of irqs to skip after
+										   data element change */
+	u_int32				modRateHigh;	/* switch to batch above [scans/s] */
+	u_int32				modRateLow;		/* switch to single below [scans/s] */
+	u_int32				modWinTicks;	/* rate measurement window [ticks] */
+	u_int32				modWinStart;	/* start of current window [tick] */
+	u_int32				modScans;		/* scans in current window */
+	u_int32				modToBatch;		/* switches to batched mode */
+	u_int32				modToSingle;	/* switches to single scan mode */
+	u_int32				modTicks[2];	/* ticks in single/batched mode */
+	u_int32				tickRate;		/* OSS ticks per second */
+
+	/* register shadow (see CTRL_WRITE) */
+	u_int16				ctrlShadow;		/* CTRL_REG without RST/CAL */
+	u_int16				adrShadow[CH_NUMBER_SINGLE];	/* ADR_REG(i) */
+	u_int16				cfgShadow[CH_NUMBER_SINGLE];	/* CFG_REG(i) */
 
 	/* misc for M36N support */
     u_int32         	modType;        /* MOD_ID_M36 or MOD_ID_M36N */
@@ -280,6 +532,20 @@ typedef struct {
 	u_int32		gain[CH_NUMBER_SINGLE];		/* gain factor */
 	u_int32		dataReg[CH_NUMBER_SINGLE];	/* data register */
 	u_int32		cfgReg[CH_NUMBER_SINGLE];	/* config register */
+
+	/* scan plan (built by InitAllChan) */
+	u_int32		scanReg[CH_NUMBER_SINGLE];	/* data reg of n-th enabled ch */
+	int32		scanNbr;					/* nbr of scan plan entries */
+	u_int32		scanContig;					/* scan plan is DATA_REG(0..n-1) */
+	u_int8		scanCh[CH_NUMBER_SINGLE];	/* channel of n-th plan entry */
+
+	/* latest complete scan (seqlock, written by M36_Irq) */
+	volatile u_int32	snapLock;			/* odd = update in progress */
+	volatile u_int32 snapSeq;				/* scan sequence number */
+	volatile u_int32 snapStamp;				/* interrupt timestamp */
+	volatile u_int16 snapMask;				/* channels in snapData */
+	volatile u_int16 snapGen;				/* config generation */
+	volatile u_int16 snapData[CH_NUMBER_SINGLE];	/* samples by channel */
 } LL_HANDLE;
 
 /* include files which need LL_HANDLE */
@@ -295,7 +561,59 @@ static int32 Cleanup(LL_HANDLE *llHdl, int32 retCode);
 static void PldLoad(LL_HANDLE *llHdl);
 static int32 Calibrate(LL_HANDLE *llHdl);
 static void InitAllChan(LL_HANDLE *llHdl);
+static void ProgramChan(LL_HANDLE *llHdl);
 static void ConfigChan(LL_HANDLE *llHdl, int32 ch);
+static void TrigMode(LL_HANDLE *llHdl, u_int32 extTrig);
+static void CommitConfig(LL_HANDLE *llHdl);
+static void DeliverScan(LL_HANDLE *llHdl, const u_int16 *scan);
+static void StoreScan(LL_HANDLE *llHdl, const M36_FRAME_HDR *hdrP,
+					  const u_int16 *scan);
+static void TrigScan(LL_HANDLE *llHdl, const M36_FRAME_HDR *hdrP,
+					 const u_int16 *scan);
+static void IrqModerate(LL_HANDLE *llHdl);
+static void ReadScan(LL_HANDLE *llHdl, u_int16 *dst, int32 first, int32 nbr);
+static u_int32 FrameBytes(int32 nbrCh, u_int32 align);
+static int32 FrameFits(LL_HANDLE *llHdl, int32 nbrEnabled);
+static void StoreFrame(LL_HANDLE *llHdl, const u_int16 *hdr,
+					   const u_int16 *scan, int32 inIrq);
+static void FrameFill(LL_HANDLE *llHdl, u_int16 *dst, const u_int16 *hdr,
+					  const u_int16 *scan);
+static void BufqPut(LL_HANDLE *llHdl, const M36_FRAME_HDR *hdrP,
+					const u_int16 *scan);
+static void BufqDone(LL_HANDLE *llHdl);
+static int32 BufqRead(LL_HANDLE *llHdl, u_int16 *bufP, int32 size,
+					  int32 *nbrRdBytesP);
+static void SlotFill(LL_HANDLE *llHdl, u_int16 *slotP,
+					 const M36_FRAME_HDR *hdrP, const u_int16 *scan);
+static void RingPut(LL_HANDLE *llHdl, const M36_FRAME_HDR *hdrP,
+					const u_int16 *scan);
+static int32 RingRead(LL_HANDLE *llHdl, int32 rd, u_int16 *bufP,
+					  int32 size, u_int32 want, u_int32 deadline,
+					  int32 *nbrRdBytesP);
+static int32 WaitSem(LL_HANDLE *llHdl, OSS_SEM_HANDLE *semHdl, int32 tout);
+static void RingAdapt(LL_HANDLE *llHdl, int32 rd, u_int32 avail);
+static int32 InBufRead(LL_HANDLE *llHdl, u_int16 *bufP, int32 size,
+					   int32 *nbrRdBytesP);
+static int32 BufRead(LL_HANDLE *llHdl, u_int16 *bufP, int32 size,
+					 int32 *nbrRdBytesP);
+static int32 DeadlineRead(LL_HANDLE *llHdl, int32 ch, M36_DLREAD_HDR *dlP,
+						  int32 size);
+static int32 InBufDeadline(LL_HANDLE *llHdl, u_int16 *bufP, int32 size,
+						   u_int32 want, u_int32 deadline,
+						   int32 *nbrRdBytesP);
+static int32 TimeLeft(LL_HANDLE *llHdl, u_int32 startTick, u_int32 msec);
+static void DemuxPut(LL_HANDLE *llHdl, const M36_FRAME_HDR *hdrP,
+					 const u_int16 *scan);
+static int32 DemuxRead(LL_HANDLE *llHdl, int32 ch, u_int16 *bufP,
+					   int32 size, int32 *nbrRdBytesP);
+static void ScanPublish(LL_HANDLE *llHdl, const M36_FRAME_HDR *hdrP,
+						const u_int16 *scan);
+static int32 ScanLatest(LL_HANDLE *llHdl, M36_SNAPSHOT *snapP);
+static void ScanHeader(LL_HANDLE *llHdl, M36_FRAME_HDR *hdrP);
+static void DeferDrain(LL_HANDLE *llHdl);
+static void DeferTimer(void *arg);
+static void ScanStatus(LL_HANDLE *llHdl, u_int16 stat);
+static void SwTimer(void *arg);
 
 static int32 M36_Init(DESC_SPEC *descSpec, OSS_HANDLE *osHdl,
 					   MACCESS *ma, OSS_SEM_HANDLE *devSemHdl,
@@ -379,10 +697,41 @@ static int32 M36_FlashEraseBlock( LL_HANDLE *llHdl, u_int32 offset );
  *                EXT_TRIG              1                0..1
  *                BIPOLAR               0                0..1
  *                SAMPLE_ALL            0                0..1
+ *                BIN_SAMPLE            0                0..1
  *                IN_BUF/MODE           0                0..3
  *                IN_BUF/SIZE           320              0..max
  *                IN_BUF/HIGHWATER      320              0..max
+ *                IN_BUF/HIGHWATER_SCANS 0               0..max
  *                IN_BUF/TIMEOUT        1000             0..max
+ *                IN_BUF/FRAME_ALIGN    0                0,2,4,8,16,32
+ *                IN_BUF/FRAME_HEADER   0                0..1
+ *                IN_BUF/STAMP_CLOCK    0                0..1
+ *                IRQ_DEFER/ENABLE      0                0..1
+ *                IRQ_DEFER/DEPTH       256              2..max (2^n)
+ *                IRQ_DEFER/PERIOD      10               1..max
+ *                IRQ_MOD/MODE          0                0..1
+ *                IRQ_MOD/RATE_HIGH     20000            1..max
+ *                IRQ_MOD/RATE_LOW      5000             0..RATE_HIGH-1
+ *                IRQ_MOD/WINDOW        100              1..10000
+ *                SW_TIMER/PERIOD       0                0..max
+ *                SCAN_RING/DEPTH       0                0, 2..max (2^n)
+ *                SCAN_RING/WAIT        1                1..DEPTH
+ *                SCAN_RING/TIMEOUT     1000             0..max
+ *                SCAN_RING/READERS     1                1..16
+ *                SCAN_RING/WAIT_MODE   0                0..1
+ *                SCAN_RING/LATENCY     10               1..max
+ *                BUF_QUEUE/NUM         0                0, 2..max (2^n)
+ *                BUF_QUEUE/SIZE        4096             84..max
+ *                BUF_QUEUE/TIMEOUT     1000             0..max
+ *                DEMUX/DEPTH           0                0, 2..max (2^n)
+ *                DEMUX/TIMEOUT         1000             0..max
+ *                TRIGGER/ENABLE        0                0..1
+ *                TRIGGER/PRE           16               0..256
+ *                TRIGGER/POST          16               0..max
+ *                TRIGGER/CHANNEL       0                0..15
+ *                TRIGGER/LEVEL         0                0..0xffff
+ *                TRIGGER/EDGE          0                0..3
+ *                GATE/MODE             0                0..2
  *                CHANNEL_n/ENABLE      1                0..1
  *                CHANNEL_n/GAIN		0                0..3
  *
@@ -414,6 +763,17 @@ static int32 M36_FlashEraseBlock( LL_HANDLE *llHdl, u_int32 offset );
  *                   0 = sample only the enabled channels
  *                   1 = sample all channels
  *
+ *                BIN_SAMPLE stores the state of the binary input with
+ *                each scan: M36_Irq sets M36_HDR_BIN in the flags of the
+ *                frame header if BIN was 1. To keep the state exact
+ *                for each scan, it needs one scan per interrupt and is
+ *                not available with IRQ_MOD/MODE=1.
+ *
+ *                   0 = BIN not stored
+ *                   1 = BIN stored in frame header flags
+ *                Requires a stored frame header (SCAN_RING or
+ *                FRAME_HEADER=1, not with DEMUX).
+ *
  *                MODE defines the buffer's block i/o mode (see MDIS-Doc.):
  *
  *                   0 = M_BUF_USRCTRL
@@ -427,9 +787,220 @@ static int32 M36_FlashEraseBlock( LL_HANDLE *llHdl, u_int32 offset );
  *                HIGHWATER defines the buffer level in [bytes], of the
  *                corresponding highwater buffer event (see MDIS-Doc.).
  *
+ *                HIGHWATER_SCANS defines the highwater level in whole
+ *                scans instead (frame size of the initially enabled
+ *                channels incl. header/alignment). 0 = use HIGHWATER.
+ *
  *                TIMEOUT defines the buffers read timeout [msec]
  *                (where timeout=0: no timeout) (see MDIS-Doc.).
  *
+ *                FRAME_ALIGN enables the scan aligned buffer layout for
+ *                the buffered input modes. Each scan is stored as one
+ *                frame, padded with zero words to a multiple of
+ *                FRAME_ALIGN bytes (2 = no padding). The buffer SIZE is
+ *                rounded down to whole frames, so a frame never wraps
+ *                around the buffer end. The frame size can be queried via
+ *                the M36_FRAME_SIZE getstat.
+ *
+ *                   0 = off (scans may wrap around the buffer end)
+ *                   2 = whole scans
+ *                  16 = frames padded to 16 bytes
+ *                  32 = frames padded to 32 bytes (all channel sets)
+ *
+ *                Note: SIZE is rounded for the channel set at init. A
+ *                      later channel set (M36_CH_ENABLE, M36_BLK_CONFIG,
+ *                      M36_CFG_COMMIT) is rejected with ERR_LL_ILL_PARAM
+ *                      if SIZE is no multiple of its frame size. This is
+ *                      always true for FRAME_ALIGN=32 without
+ *                      FRAME_HEADER. With FRAME_HEADER=1 (20 bytes), use
+ *                      a SIZE that is a multiple of all needed frame sizes.
+ *
+ *                FRAME_HEADER precedes each scan in the input buffer with
+ *                a M36_FRAME_HDR (see m36_drv.h): scan sequence number,
+ *                timestamp of the interrupt, enabled channel mask and
+ *                configuration generation. Gaps in the sequence number
+ *                show lost scans, a new generation shows a changed
+ *                channel configuration (enable, gain, measuring mode).
+ *                Flags mark special scans and carry the state of the
+ *                binary input (M36_HDR_xxx, see BIN_SAMPLE).
+ *
+ *                   0 = samples only
+ *                   1 = header + samples
+ *
+ *                STAMP_CLOCK selects the clock of the timestamps (frame
+ *                header, snapshot, M36_STATS.irqTimeMax). The default
+ *                OSS tick counter only resolves 1/tickRate (typically
+ *                1..10ms), so several scans share the same stamp at
+ *                higher scan rates. The CPU cycle counter (low 32 bits,
+ *                wraps after ~1s at GHz clocks) resolves single scans;
+ *                it is only available on x86 CPUs, otherwise M36_Init
+ *                fails with ERR_LL_ILL_PARAM.
+ *
+ *                   0 = OSS ticks (see M36_IRQMOD.tickRate)
+ *                   1 = CPU cycles
+ *
+ *                IRQ_DEFER/ENABLE splits the interrupt handling into a
+ *                minimal top half and a deferred bottom half.
+ *                The top half (M36_Irq) only resets the interrupt and
+ *                copies the data registers into a lock-free single
+ *                producer/single consumer ring. The bottom half moves the
+ *                scans from this ring into the input buffer (including
+ *                highwater signalling). It runs periodically from an OSS
+ *                timer, which is the only consumer of the ring, so scans
+ *                reach the input buffer with up to one PERIOD delay.
+ *                The interrupt is only masked around the input buffer
+ *                bookkeeping, not while a frame is copied.
+ *
+ *                   0 = all work done in M36_Irq
+ *                   1 = top/bottom half split
+ *
+ *                IRQ_DEFER/DEPTH defines the number of scans the ring can
+ *                hold (power of two). Scans are lost if the ring is full.
+ *
+ *                IRQ_DEFER/PERIOD defines the bottom half timer period
+ *                [msec].
+ *
+ *                IRQ_MOD/MODE enables the adaptive interrupt moderation.
+ *                The scan rate is measured in M36_Irq. If it exceeds
+ *                RATE_HIGH [scans/s], the data elements are programmed to
+ *                sample the enabled channels k times per measurement cycle
+ *                (k = 16 / nbr of enabled channels), so one interrupt
+ *                delivers k scans. If the rate drops below RATE_LOW, the
+ *                driver switches back to one scan per interrupt.
+ *                Requires k > 1, i.e. 1..8 enabled channels, and is not
+ *                available with SAMPLE_ALL=1 or BIN_SAMPLE=1, otherwise
+ *                M36_Init fails with ERR_LL_ILL_PARAM. If more channels
+ *                are enabled later (M36_CH_ENABLE), the driver stays at
+ *                one scan per interrupt (see M36_IRQMOD.batchMax).
+ *                (see also M36_IRQ_MOD)
+ *
+ *                   0 = off (one scan per interrupt)
+ *                   1 = adaptive
+ *
+ *                IRQ_MOD/WINDOW defines the rate measurement window [msec].
+ *
+ *                SW_TIMER/PERIOD enables the software-timed sampling with
+ *                the given timer period [msec] (e.g. 1 = 1kHz, 1000 = 1Hz).
+ *                A periodic OSS timer reads the data registers of the
+ *                enabled channels and stores the scan with timestamp like
+ *                M36_Irq does. The interrupt must stay disabled while
+ *                the timer runs (M_MK_IRQ_ENABLE returns ERR_LL_ILL_FUNC).
+ *                The module keeps converting at its own rate, the timer
+ *                waits for the next end of scan (max. 1ms) and takes
+ *                these conversion results. Not available with
+ *                IRQ_MOD. The period can be changed with M36_SW_PERIOD,
+ *                M36_SW_PERIOD=0 stops the timer and allows to switch to
+ *                interrupt mode (and back, with the interrupt disabled).
+ *                (0 = off)
+ *
+ *                SCAN_RING/DEPTH enables the driver scan ring with DEPTH
+ *                slots instead of the input buffer. M36_Irq stores each
+ *                scan as slot (M36_FRAME_HDR + 16 sample words, only
+ *                M36_FRAME_HDR.nbrCh samples valid) and M36_BlockRead
+ *                returns whole slots. Not available with IRQ_DEFER.
+ *                (0 = off)
+ *
+ *                SCAN_RING/WAIT defines the nbr of scans M36_BlockRead
+ *                waits for (limited by the user buffer size), see also
+ *                M36_RING_WAIT.
+ *
+ *                SCAN_RING/TIMEOUT defines the wait timeout [msec]
+ *                (where timeout=0: no timeout).
+ *
+ *                SCAN_RING/READERS defines the nbr of independent read
+ *                cursors on the scan ring. The cursor is selected by the
+ *                current channel of the path (0..READERS-1), so several
+ *                paths can read the same scans. Each cursor has its own
+ *                fill level, highwater and lost counter (M36_BLK_RING).
+ *                With READERS=1, new scans are lost if the ring is full.
+ *                With READERS>1, M36_Irq never waits for a reader: it
+ *                overwrites the oldest slots and a reader falling behind
+ *                by more than DEPTH-1 scans loses the overwritten scans.
+ *
+ *                SCAN_RING/WAIT_MODE selects the wakeup batch (nbr of
+ *                scans a reader waits for) of each read cursor:
+ *
+ *                   0 = fixed (SCAN_RING/WAIT)
+ *                   1 = adaptive, starting with SCAN_RING/WAIT
+ *
+ *                In adaptive mode, the batch is doubled while the reader
+ *                keeps up (no more than the batch available on wakeup)
+ *                and the batch at the measured scan rate stays below
+ *                SCAN_RING/LATENCY [msec]. It is halved when the fill
+ *                level exceeds the batch by more than the batch or half
+ *                the ring, or the latency target is exceeded. This saves
+ *                wakeups at high scan rates without adding latency at
+ *                low rates (see M36_RING_INFO.batch).
+ *
+ *                BUF_QUEUE/NUM enables a queue of NUM driver buffers
+ *                instead of the input buffer. M36_Irq fills the buffers
+ *                frame by frame (layout as in the input buffer). A full
+ *                buffer is completed, M36_BlockRead dequeues it as
+ *                M36_BUFQ_HDR (fill level, nbr of scans, sequence number
+ *                and timestamp of the first scan) followed by the frames
+ *                and requeues it. Not available with IRQ_DEFER or
+ *                SCAN_RING. (0 = off)
+ *
+ *                BUF_QUEUE/SIZE defines the data size of each buffer
+ *                [bytes], rounded down to a multiple of 4.
+ *
+ *                BUF_QUEUE/TIMEOUT defines the dequeue timeout [msec]
+ *                (where timeout=0: no timeout). On timeout, a partially
+ *                filled buffer is completed and returned.
+ *
+ *                DEMUX/DEPTH enables the demultiplexed mode instead of the
+ *                input buffer. M36_Irq stores the samples of each enabled
+ *                channel into a ring of DEPTH samples of this channel,
+ *                M36_BlockRead returns the contiguous samples of the
+ *                current channel only. Each channel ring has its own
+ *                fill level and lost counter (M36_DEMUX_LEVEL/LOST).
+ *                Not available with IRQ_DEFER, SCAN_RING or BUF_QUEUE.
+ *                (0 = off)
+ *
+ *                DEMUX/TIMEOUT defines the read timeout [msec]
+ *                (where timeout=0: no timeout).
+ *
+ *                TRIGGER/ENABLE enables the software trigger capture
+ *                mode. M36_Irq keeps the last PRE scans as pre-trigger
+ *                history and checks the sample of CHANNEL against LEVEL
+ *                (raw value, signed in bipolar mode) for each scan:
+ *
+ *                   0 = M36_TRG_RISING   rising edge through LEVEL
+ *                   1 = M36_TRG_FALLING  falling edge through LEVEL
+ *                   2 = M36_TRG_ABOVE    sample >= LEVEL
+ *                   3 = M36_TRG_BELOW    sample <= LEVEL
+ *
+ *                When the condition fires, one window of PRE scans, the
+ *                trigger scan and POST scans is stored, all other scans
+ *                are discarded. The next trigger is accepted as soon as
+ *                the history holds PRE new scans again. A change of the
+ *                channel configuration clears the history. Channel,
+ *                level and edge can also be changed with M36_TRG_xxx.
+ *                PRE is limited to 256, since the interrupt that fires
+ *                stores the whole history. One window (PRE+1+POST scans)
+ *                must fit into the storage that receives it (SCAN_RING,
+ *                BUF_QUEUE, DEMUX, IRQ_DEFER ring or input buffer with
+ *                the initially enabled channels), otherwise M36_Init
+ *                fails with ERR_LL_ILL_PARAM.
+ *
+ *                GATE/MODE gates the acquisition by the binary input
+ *                (BIN). M36_Irq samples BIN with each interrupt and
+ *                stores scans only while the gate is open:
+ *
+ *                   0 = M36_GATE_OFF   no gating
+ *                   1 = M36_GATE_HIGH  store scans while BIN=1
+ *                   2 = M36_GATE_LOW   store scans while BIN=0
+ *
+ *                Scans outside the gate are discarded without reading
+ *                the data registers, but still get a sequence number.
+ *                The first stored scan of a gate window is marked with
+ *                M36_HDR_GATE_START in the frame header. Requires a
+ *                stored frame header (SCAN_RING or FRAME_HEADER=1, not
+ *                with DEMUX), otherwise the gate windows could not be
+ *                told apart.
+ *                With TRIGGER/ENABLE=1, only scans inside the gate are
+ *                passed to the software trigger.
+ *
  *                ENABLE enables/disables channel n. If disabled,
  *                the corresponding channel can not be read.
  *
@@ -447,7 +1018,7 @@ static int32 M36_FlashEraseBlock( LL_HANDLE *llHdl, u_int32 offset );
  *  Input......:  descSpec   pointer to descriptor data
  *                osHdl      oss handle
  *                ma         hw access handle
- *                devSemHdl  device semaphore handle
+ *                devSemHdl  device semaphore handle (not used)
  *                irqHdl     irq handle
  *  Output.....:  llHdlP     ptr to low level driver handle
  *                return     success (0) or error code
@@ -464,7 +1035,8 @@ static int32 M36_Init(
 {
     LL_HANDLE *llHdl = NULL;
     u_int32 gotsize, pldLoad, ch;
-    u_int32 bufSize, bufMode, bufTout, bufHigh, bufDbgLevel;
+    u_int32 bufSize, bufMode, bufTout, bufHigh, bufHighScans, bufDbgLevel;
+    u_int32 dfrDepth, room;
     int32 error;
     u_int32 value;
 
@@ -506,6 +1078,14 @@ static int32 M36_Init(
 
     DBGWRT_1((DBH, "LL - M36_Init\n"));
 
+    /*------------------------------+
+    |  create locks (LL_LOCK_NONE)  |
+    +------------------------------*/
+	if ((error = OSS_SemCreate(osHdl, OSS_SEM_BIN, 1, &llHdl->rdSemHdl)) ||
+		(error = OSS_SemCreate(osHdl, OSS_SEM_BIN, 1, &llHdl->cfgSemHdl)) ||
+		(error = OSS_SemCreate(osHdl, OSS_SEM_BIN, 0, &llHdl->dlSem)))
+		return( Cleanup(llHdl,error) );
+
     /*------------------------------+
     |  scan descriptor              |
     +------------------------------*/
@@ -586,6 +1166,15 @@ static int32 M36_Init(
 	if (llHdl->bipolar > 1)
 		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
 
+	/* BIN_SAMPLE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->binSample,
+								"BIN_SAMPLE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->binSample > 1)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
     /* IN_BUF/SIZE */
     if ((error = DESC_GetUInt32(llHdl->descHdl, 320, &bufSize,
 								"IN_BUF/SIZE")) &&
@@ -613,6 +1202,284 @@ static int32 M36_Init(
 		error != ERR_DESC_KEY_NOTFOUND)
 		return( Cleanup(llHdl,error) );
 
+	/* IN_BUF/HIGHWATER_SCANS */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &bufHighScans,
+								"IN_BUF/HIGHWATER_SCANS")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	/* IN_BUF/FRAME_ALIGN */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->frameAlign,
+								"IN_BUF/FRAME_ALIGN")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((llHdl->frameAlign != 0) &&
+		((llHdl->frameAlign < CH_BYTES) ||
+		 (llHdl->frameAlign > FRAME_MAX_ALIGN) ||
+		 (llHdl->frameAlign & (llHdl->frameAlign - 1))))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* IN_BUF/FRAME_HEADER */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->frameHdr,
+								"IN_BUF/FRAME_HEADER")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->frameHdr > 1)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	llHdl->hdrWords = llHdl->frameHdr ? FRAME_HDR_WORDS : 0;
+
+	/* IN_BUF/STAMP_CLOCK */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->stampClock,
+								"IN_BUF/STAMP_CLOCK")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+#ifdef M36_CYCLES
+	if (llHdl->stampClock > 1)
+#else
+	if (llHdl->stampClock != 0)
+#endif
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* IRQ_DEFER/ENABLE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->dfrEnable,
+								"IRQ_DEFER/ENABLE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->dfrEnable > 1)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* IRQ_DEFER/DEPTH */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 256, &dfrDepth,
+								"IRQ_DEFER/DEPTH")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((dfrDepth < 2) || (dfrDepth & (dfrDepth - 1)))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* IRQ_DEFER/PERIOD */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 10, &llHdl->dfrPeriod,
+								"IRQ_DEFER/PERIOD")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->dfrPeriod == 0)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* SCAN_RING/DEPTH */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->ringDepth,
+								"SCAN_RING/DEPTH")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((llHdl->ringDepth == 1) ||
+		(llHdl->ringDepth & (llHdl->ringDepth - 1)) ||
+		(llHdl->ringDepth && llHdl->dfrEnable))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* SCAN_RING/WAIT */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 1, &llHdl->ringWait,
+								"SCAN_RING/WAIT")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((llHdl->ringWait == 0) ||
+		(llHdl->ringDepth && (llHdl->ringWait > llHdl->ringDepth)))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* SCAN_RING/TIMEOUT */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 1000, &value,
+								"SCAN_RING/TIMEOUT")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	llHdl->ringTout = value ? (int32)value : OSS_SEM_WAITINFINITE;
+
+	/* SCAN_RING/READERS */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 1, &llHdl->ringReaders,
+								"SCAN_RING/READERS")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((llHdl->ringReaders < 1) || (llHdl->ringReaders > llHdl->chNumber))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* SCAN_RING/WAIT_MODE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->ringAdapt,
+								"SCAN_RING/WAIT_MODE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->ringAdapt > 1)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* SCAN_RING/LATENCY */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 10, &llHdl->ringLatency,
+								"SCAN_RING/LATENCY")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->ringLatency == 0)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* BUF_QUEUE/NUM */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->bufqNum,
+								"BUF_QUEUE/NUM")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((llHdl->bufqNum == 1) ||
+		(llHdl->bufqNum & (llHdl->bufqNum - 1)) ||
+		(llHdl->bufqNum && (llHdl->dfrEnable || llHdl->ringDepth)))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* BUF_QUEUE/SIZE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 4096, &llHdl->bufqSize,
+								"BUF_QUEUE/SIZE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	/* keep the M36_BUFQ_HDR of each buffer u_int32 aligned */
+	llHdl->bufqSize &= ~(sizeof(u_int32) - 1);
+
+	/* at least one frame of any channel set */
+	if (llHdl->bufqSize < FRAME_MAX_WORDS * CH_BYTES)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* BUF_QUEUE/TIMEOUT */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 1000, &value,
+								"BUF_QUEUE/TIMEOUT")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	llHdl->bufqTout = value ? (int32)value : OSS_SEM_WAITINFINITE;
+
+	/* DEMUX/DEPTH */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->demuxDepth,
+								"DEMUX/DEPTH")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((llHdl->demuxDepth == 1) ||
+		(llHdl->demuxDepth & (llHdl->demuxDepth - 1)) ||
+		(llHdl->demuxDepth &&
+		 (llHdl->dfrEnable || llHdl->ringDepth || llHdl->bufqNum)))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* DEMUX/TIMEOUT */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 1000, &value,
+								"DEMUX/TIMEOUT")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	llHdl->demuxTout = value ? (int32)value : OSS_SEM_WAITINFINITE;
+
+	/* TRIGGER/ENABLE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->trgEnable,
+								"TRIGGER/ENABLE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	/* TRIGGER/PRE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 16, &llHdl->trgPre,
+								"TRIGGER/PRE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	/* TRIGGER/POST */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 16, &llHdl->trgPost,
+								"TRIGGER/POST")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	/* TRIGGER/CHANNEL */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->trgCh,
+								"TRIGGER/CHANNEL")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	/* TRIGGER/LEVEL */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->trgLevel,
+								"TRIGGER/LEVEL")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	/* TRIGGER/EDGE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, M36_TRG_RISING,
+								&llHdl->trgEdge, "TRIGGER/EDGE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((llHdl->trgEnable > 1) || (llHdl->trgPre > TRG_PRE_MAX) ||
+		(llHdl->trgCh >= llHdl->chNumber) || (llHdl->trgLevel > 0xffff) ||
+		(llHdl->trgEdge > M36_TRG_BELOW))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* GATE/MODE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, M36_GATE_OFF,
+								&llHdl->gateMode, "GATE/MODE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->gateMode > M36_GATE_LOW)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* header flags need a stored frame header */
+	if ((llHdl->binSample || llHdl->gateMode) && !HDR_STORED(llHdl))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* IRQ_MOD/MODE */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->modMode,
+								"IRQ_MOD/MODE")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->modMode > 1)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* IRQ_MOD/RATE_HIGH */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 20000, &llHdl->modRateHigh,
+								"IRQ_MOD/RATE_HIGH")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	/* IRQ_MOD/RATE_LOW */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 5000, &llHdl->modRateLow,
+								"IRQ_MOD/RATE_LOW")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->modRateLow >= llHdl->modRateHigh)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* IRQ_MOD/WINDOW */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 100, &value,
+								"IRQ_MOD/WINDOW")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if ((value == 0) || (value > 10000))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	/* SW_TIMER/PERIOD */
+	if ((error = DESC_GetUInt32(llHdl->descHdl, 0, &llHdl->swPeriod,
+								"SW_TIMER/PERIOD")) &&
+		error != ERR_DESC_KEY_NOTFOUND)
+		return( Cleanup(llHdl,error) );
+
+	if (llHdl->swPeriod && llHdl->modMode)
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
+	llHdl->tickRate = OSS_TickRateGet(llHdl->osHdl);
+	llHdl->modWinTicks = (value * llHdl->tickRate + 999) / 1000;
+	llHdl->modWinStart = OSS_TickGet(llHdl->osHdl);
+	llHdl->batch = 1;
+
 	/* clear number of enabled channels */
 	llHdl->nbrEnabledCh = 0;
 
@@ -641,11 +1508,61 @@ static int32 M36_Init(
 			return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
 	}
 
+	/* irq moderation needs room for more than one scan */
+	if (llHdl->modMode && (BATCH_MAX(llHdl, llHdl->nbrEnabledCh) == 1))
+		return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+
     /*------------------------------+
     |  install buffer               |
     +------------------------------*/
+	/* scan aligned layout: round buffer size down to whole frames */
+	if (llHdl->frameAlign && llHdl->nbrEnabledCh) {
+		value = FrameBytes(llHdl->hdrWords + llHdl->nbrEnabledCh,
+						   llHdl->frameAlign);
+		bufSize -= bufSize % value;
+
+		if (bufSize == 0)
+			return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+	}
+	llHdl->bufSize = bufSize;
+
+	/* highwater in whole scans */
+	if (bufHighScans) {
+		bufHigh = bufHighScans *
+			FrameBytes(llHdl->hdrWords + llHdl->nbrEnabledCh,
+					   llHdl->frameAlign);
+
+		if (bufHigh > bufSize)
+			bufHigh = bufSize;
+	}
+
+	/* software trigger: one capture window must fit into the storage */
+	if (llHdl->trgEnable) {
+		value = FrameBytes(llHdl->hdrWords + llHdl->nbrEnabledCh,
+						   llHdl->frameAlign);
+
+		if (llHdl->ringDepth)
+			room = llHdl->ringDepth;
+		else if (llHdl->bufqNum)
+			room = llHdl->bufqNum * (value ? llHdl->bufqSize / value : 0);
+		else if (llHdl->demuxDepth)
+			room = llHdl->demuxDepth;
+		else if (llHdl->dfrEnable)
+			room = dfrDepth;
+		else
+			room = value ? bufSize / value : 0;
+
+		if ((llHdl->trgPre >= room) ||
+			(llHdl->trgPost > room - 1 - llHdl->trgPre)) {
+			DBGWRT_ERR((DBH, " *** M36_Init: trigger window %d+1+%d "
+						"exceeds storage of %d scans\n", llHdl->trgPre,
+						llHdl->trgPost, room));
+			return( Cleanup(llHdl,ERR_LL_ILL_PARAM) );
+		}
+	}
+
 	/* create input buffer */
-	if ((error = MBUF_Create(llHdl->osHdl, devSemHdl, llHdl,
+	if ((error = MBUF_Create(llHdl->osHdl, llHdl->rdSemHdl, llHdl,
 							 bufSize, CH_BYTES, bufMode, MBUF_RD,
 							 bufHigh, bufTout, irqHdl, &llHdl->bufHdl)))
 		return( Cleanup(llHdl,error) );
@@ -653,6 +1570,91 @@ static int32 M36_Init(
 	/* set debug level */
 	MBUF_SetStat(llHdl->bufHdl, NULL, M_BUF_RD_DEBUG_LEVEL, bufDbgLevel);
 
+    /*------------------------------+
+    |  install scan ring            |
+    +------------------------------*/
+	if (llHdl->ringDepth) {
+		llHdl->ringMask = llHdl->ringDepth - 1;
+
+		if ((llHdl->ring = (u_int16*)OSS_MemGet(llHdl->osHdl,
+							llHdl->ringDepth * RING_SLOT_WORDS * CH_BYTES,
+							&llHdl->ringSize)) == NULL)
+			return( Cleanup(llHdl,ERR_OSS_MEM_ALLOC) );
+
+		for (ch=0; ch<llHdl->ringReaders; ch++) {
+			if ((error = OSS_SemCreate(llHdl->osHdl, OSS_SEM_BIN, 0,
+									   &llHdl->ringSem[ch])))
+				return( Cleanup(llHdl,error) );
+
+			llHdl->ringBatch[ch]    = llHdl->ringWait;
+			llHdl->ringRateTick[ch] = OSS_TickGet(llHdl->osHdl);
+		}
+	}
+
+    /*------------------------------+
+    |  install buffer queue         |
+    +------------------------------*/
+	if (llHdl->bufqNum) {
+		llHdl->bufqMask   = llHdl->bufqNum - 1;
+		llHdl->bufqStride = (sizeof(M36_BUFQ_HDR) + llHdl->bufqSize)
+							/ CH_BYTES;
+
+		if ((llHdl->bufq = (u_int16*)OSS_MemGet(llHdl->osHdl,
+							llHdl->bufqNum * llHdl->bufqStride * CH_BYTES,
+							&llHdl->bufqAlloc)) == NULL)
+			return( Cleanup(llHdl,ERR_OSS_MEM_ALLOC) );
+
+		OSS_MemFill(llHdl->osHdl, llHdl->bufqAlloc, (char*)llHdl->bufq, 0);
+
+		if ((error = OSS_SemCreate(llHdl->osHdl, OSS_SEM_BIN, 0,
+								   &llHdl->bufqSem)))
+			return( Cleanup(llHdl,error) );
+	}
+
+    /*------------------------------+
+    |  install channel rings        |
+    +------------------------------*/
+	if (llHdl->demuxDepth) {
+		llHdl->demuxMask = llHdl->demuxDepth - 1;
+
+		if ((llHdl->demux = (u_int16*)OSS_MemGet(llHdl->osHdl,
+							llHdl->chNumber * llHdl->demuxDepth * CH_BYTES,
+							&llHdl->demuxAlloc)) == NULL)
+			return( Cleanup(llHdl,ERR_OSS_MEM_ALLOC) );
+
+		for (ch=0; ch<llHdl->chNumber; ch++)
+			if ((error = OSS_SemCreate(llHdl->osHdl, OSS_SEM_BIN, 0,
+									   &llHdl->demuxSem[ch])))
+				return( Cleanup(llHdl,error) );
+	}
+
+    /*------------------------------+
+    |  install trigger history      |
+    +------------------------------*/
+	if (llHdl->trgEnable) {
+		/* power of two >= PRE + trigger scan */
+		for (value=1; value < llHdl->trgPre + 1; value <<= 1)
+			;
+		llHdl->trgMask = value - 1;
+
+		if ((llHdl->trgHist = (u_int16*)OSS_MemGet(llHdl->osHdl,
+							value * TRG_SLOT_WORDS * CH_BYTES,
+							&llHdl->trgHistSize)) == NULL)
+			return( Cleanup(llHdl,ERR_OSS_MEM_ALLOC) );
+	}
+
+    /*------------------------------+
+    |  install deferred irq ring    |
+    +------------------------------*/
+	if (llHdl->dfrEnable) {
+		llHdl->dfrMask = dfrDepth - 1;
+
+		if ((llHdl->dfrRing = (u_int16*)OSS_MemGet(llHdl->osHdl,
+							dfrDepth * DFR_SLOT_WORDS * CH_BYTES,
+							&llHdl->dfrRingSize)) == NULL)
+			return( Cleanup(llHdl,ERR_OSS_MEM_ALLOC) );
+	}
+
     /*------------------------------+
     |  check module id              |
     +------------------------------*/
@@ -689,18 +1691,49 @@ static int32 M36_Init(
     /*------------------------------+
     |  init hardware                |
     +------------------------------*/
+	/* register contents unknown after reset/PLD load */
+	for (ch=0; ch<CH_NUMBER_SINGLE; ch++)
+		llHdl->adrShadow[ch] = llHdl->cfgShadow[ch] = SHADOW_INVALID;
+
 	/* config the trigger mode */
-	MWRITE_D16(llHdl->ma, CTRL_REG, llHdl->extTrig ? EXT : 0x00);
+	CTRL_WRITE(llHdl, llHdl->extTrig ? EXT : 0x00);
 
 	/* initialize all channels */
 	InitAllChan(llHdl);
 
 	/* start calibration if its not a M36N */
-	if (llHdl->modType != MOD_ID_M36N)
-		return( Calibrate(llHdl) );
-	else
-		return(ERR_SUCCESS);
+	if ((llHdl->modType != MOD_ID_M36N) &&
+		(error = Calibrate(llHdl)))
+		return( Cleanup(llHdl,error) );
 
+    /*------------------------------+
+    |  start bottom half timer      |
+    +------------------------------*/
+	/* not before the channels are initialized (scan readers) */
+	if (llHdl->dfrEnable) {
+		if ((error = OSS_TimerCreate(llHdl->osHdl, DeferTimer, llHdl,
+									 &llHdl->dfrTimer)))
+			return( Cleanup(llHdl,error) );
+
+		if ((error = OSS_TimerStart(llHdl->osHdl, llHdl->dfrTimer,
+									llHdl->dfrPeriod, TRUE)))
+			return( Cleanup(llHdl,error) );
+	}
+
+    /*------------------------------+
+    |  start sampling timer         |
+    +------------------------------*/
+	if (llHdl->swPeriod) {
+		if ((error = OSS_TimerCreate(llHdl->osHdl, SwTimer, llHdl,
+									 &llHdl->swTimer)))
+			return( Cleanup(llHdl,error) );
+
+		if ((error = OSS_TimerStart(llHdl->osHdl, llHdl->swTimer,
+									llHdl->swPeriod, TRUE)))
+			return( Cleanup(llHdl,error) );
+	}
+
+	return(ERR_SUCCESS);
 }
 
 
@@ -744,6 +1777,19 @@ static int32 M36_Exit(
  *
  *                The function reads the state of the current channel.
  *
+ *                While the interrupt or the sampling timer (SW_TIMER) is
+ *                enabled, the value is taken from the latest complete
+ *                scan published by M36_Irq or the timer without bus
+ *                access, if this is the newest scan. Otherwise the data
+ *                register is read:
+ *                - interrupt and sampling timer disabled
+ *                - no scan of the current channel configuration yet
+ *                - newer scans were not published (gate closed, between
+ *                  trigger windows, deferred scans not yet drained)
+ *                - finite acquisition complete (no more scans)
+ *                The register is read with the config lock held, so the
+ *                channel set cannot change meanwhile.
+ *
  *                If the channel is not enabled an ERR_LL_READ error
  *                is returned.
  *
@@ -760,16 +1806,34 @@ static int32 M36_Read(
     int32 *value
 )
 {
+	M36_SNAPSHOT snap;
+	int32 error = ERR_SUCCESS;
+
     DBGWRT_1((DBH, "LL - M36_Read: ch=%d\n",ch));
 
 	/* channel disabled ? */
 	if ( llHdl->enable[ch] == 0)
 		return(ERR_LL_READ);
 
-	/* read value of channel */
-	*value = MREAD_D16(llHdl->ma, llHdl->dataReg[ch]);
+	/* latest complete scan, if not stale */
+	if ( (llHdl->irqEnabled || llHdl->swPeriod) &&
+		 (ScanLatest(llHdl, &snap) == ERR_SUCCESS) &&
+		 (snap.chMask & (1 << ch)) &&
+		 (snap.seq + 1 == llHdl->scanSeq) &&
+		 !(llHdl->acqCount && (llHdl->acqLeft == 0)) ) {
+		*value = snap.data[ch];
+		return(ERR_SUCCESS);
+	}
+
+	/* read value of channel (config lock: consistent channel set) */
+	OSS_SemWait(llHdl->osHdl, llHdl->cfgSemHdl, OSS_SEM_WAITINFINITE);
+	if ( llHdl->enable[ch] == 0)
+		error = ERR_LL_READ;
+	else
+		*value = MREAD_D16(llHdl->ma, llHdl->dataReg[ch]);
+	OSS_SemSignal(llHdl->osHdl, llHdl->cfgSemHdl);
 
-	return(ERR_SUCCESS);
+	return(error);
 }
 
 /****************************** M36_Write ************************************
@@ -832,6 +1896,58 @@ static int32 M36_Write( /* nodoc */
  *                M36_CALIBRATE        start calibration          -
  *                                      Note: interrupt must be
  *                                            disabled
+ *                M36_IRQ_MOD          adaptive irq moderation    0..1
+ *                                      0 = off
+ *                                      1 = adaptive (not if only one
+ *                                          scan fits, see IRQ_MOD/MODE)
+ *                M36_BLK_CONFIG       channel configuration      M36_CONFIG
+ *                                     (block setstat)
+ *                                      enable mask, gain factors,
+ *                                      measuring and sampling mode
+ *                                      are validated first and then
+ *                                      programmed in one pass
+ *                                      (with M36_IRQ_MOD=1 max. 8
+ *                                      enabled channels)
+ *                M36_CFG_STAGE        staged configuration       0..1
+ *                                      0 = immediate (default)
+ *                                      1 = staged: M36_CH_ENABLE,
+ *                                          M36_CH_GAIN, M36_BIPOLAR,
+ *                                          M36_EXT_TRIG and
+ *                                          M36_BLK_CONFIG change
+ *                                          only the staged config
+ *                                      Switching back to 0 discards
+ *                                      uncommitted changes.
+ *                M36_RING_WAIT        scans to wait for          1..DEPTH
+ *                                     (SCAN_RING only)
+ *                M36_CFG_COMMIT       commit staged config       -
+ *                                      Applied by M36_Irq between
+ *                                      two scans (or at once, if the
+ *                                      interrupt is disabled). The
+ *                                      configuration generation
+ *                                      (M36_CFG_GEN) is incremented.
+ *                M36_ACQ_COUNT        arm finite acquisition     0..max
+ *                                      0 = continuous (default)
+ *                                      n = deliver the next n scans,
+ *                                          then ignore all further
+ *                                          scans until re-armed
+ *                M36_ACQ_SIGSET       install completion signal  signal
+ *                M36_ACQ_SIGCLR       remove completion signal   -
+ *                M36_TRG_CH           trigger channel            0..15
+ *                M36_TRG_LEVEL        trigger level (raw)        0..0xffff
+ *                M36_TRG_EDGE         trigger condition          0..3
+ *                                     (TRIGGER/ENABLE=1 only)
+ *                M36_SW_PERIOD        sw-timed sampling [msec]   0..max
+ *                                      0 = timer stopped
+ *                                     (SW_TIMER/PERIOD>0 only,
+ *                                      interrupt disabled)
+ *                M36_BIN_SAMPLE       BIN into header flags      0..1
+ *                                     (frame header stored only)
+ *                                     (not with M36_IRQ_MOD=1)
+ *                M36_GATE_MODE        gating by binary input     0..2
+ *                                     (frame header stored only)
+ *                                      0 = off
+ *                                      1 = store scans while BIN=1
+ *                                      2 = store scans while BIN=0
  *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl          ll handle
@@ -857,10 +1973,17 @@ static int32 M36_SetStat(
     M_SG_BLOCK *sg = (M_SG_BLOCK *)valueP;
 	u_int16 *dataP;
 	u_int32 i = 0;
+	OSS_IRQ_STATE irqState;
+	OSS_SEM_HANDLE *lockHdl;
+	OSS_SIG_HANDLE *sigHdl;
 
     DBGWRT_1((DBH, "LL - M36_SetStat: ch=%d code=0x%04x value=0x%x\n",
 			  ch,code,value));
 
+	/* input buffer codes: read lock, all others: config lock */
+	lockHdl = M_BUF_CODE(code) ? llHdl->rdSemHdl : llHdl->cfgSemHdl;
+	OSS_SemWait(llHdl->osHdl, lockHdl, OSS_SEM_WAITINFINITE);
+
     switch(code) {
         /*--------------------------+
 		 |  debug level             |
@@ -872,6 +1995,11 @@ static int32 M36_SetStat(
 		  |  enable interrupts      |
 		  +------------------------*/
 	case M_MK_IRQ_ENABLE:
+		if ( value && llHdl->swPeriod ) {	/* software-timed sampling */
+			error = ERR_LL_ILL_FUNC;
+			break;
+		}
+		llHdl->irqEnabled = value;		/* for M36_CFG_COMMIT */
 		error = 0 /* ERR_LL_UNK_CODE */;	/* say: not supported */
 		break;
         /*--------------------------+
@@ -895,7 +2023,17 @@ static int32 M36_SetStat(
 			error = ERR_LL_ILL_PARAM;
 			break;
 		}
+		/* staged config */
+		if ( llHdl->cfgStage ) {
+			llHdl->stgEnable[ch] = value;
+			break;
+		}
 		if ( llHdl->enable[ch] != (u_int32)value ) {
+			/* frames must not wrap around the buffer end */
+			if ( !FrameFits(llHdl, llHdl->nbrEnabledCh + (value ? 1 : -1)) ) {
+				error = ERR_LL_ILL_PARAM;
+				break;
+			}
 			/* update number of enabled channels */
 			value ? llHdl->nbrEnabledCh++ : llHdl->nbrEnabledCh--;
 			llHdl->enable[ch] = value;
@@ -911,6 +2049,14 @@ static int32 M36_SetStat(
 			error = ERR_LL_ILL_PARAM;
 			break;
 		}
+		/* staged config */
+		if ( llHdl->cfgStage ) {
+			if ( llHdl->stgEnable[ch] == 0)		/* channel disabled ? */
+				error = ERR_LL_DEV_BUSY;
+			else
+				llHdl->stgGain[ch] = value;
+			break;
+		}
 		/* channel disabled ? */
 		if ( llHdl->enable[ch] == 0) {
 			error = ERR_LL_DEV_BUSY;
@@ -929,6 +2075,11 @@ static int32 M36_SetStat(
 			error = ERR_LL_ILL_PARAM;
 			break;
 		}
+		/* staged config */
+		if ( llHdl->cfgStage ) {
+			llHdl->stgBipolar = value;
+			break;
+		}
 		/* update measuring mode */
 		llHdl->bipolar = value;
 		/* initialize all channels */
@@ -942,13 +2093,12 @@ static int32 M36_SetStat(
 			error = ERR_LL_ILL_PARAM;
 			break;
 		}
-		if (value){
-			MSETMASK_D16(llHdl->ma, CTRL_REG, EXT);	/* external */
-		}
-		else{
-			MCLRMASK_D16(llHdl->ma, CTRL_REG, EXT); /* internal */
+		/* staged config */
+		if ( llHdl->cfgStage ) {
+			llHdl->stgExtTrig = value;
+			break;
 		}
-		llHdl->extTrig = value;
+		TrigMode(llHdl, value);
 		break;
 		/*-------------------------+
 		  |  start calibration      |
@@ -960,6 +2110,261 @@ static int32 M36_SetStat(
 		else
 			error = ERR_LL_ILL_FUNC;
 		break;
+        /*--------------------------+
+		  | irq moderation          |
+		  +-------------------------*/
+	case M36_IRQ_MOD:
+		if ( (value < 0) || (value > 1) ||
+			 (value && (BATCH_MAX(llHdl, llHdl->nbrEnabledCh) == 1)) ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		llHdl->modMode = value;
+		llHdl->modScans = 0;
+		llHdl->modWinStart = OSS_TickGet(llHdl->osHdl);
+		if ( (value == 0) && (llHdl->batch > 1) ) {
+			/* back to one scan per interrupt */
+			llHdl->batch = 1;
+			InitAllChan(llHdl);
+		}
+		break;
+        /*--------------------------+
+		  | channel configuration   |
+		  +-------------------------*/
+	case M36_BLK_CONFIG:
+	{
+		M36_CONFIG *cfgP = (M36_CONFIG*)sg->data;
+		u_int32 nbr;							/* enabled channels */
+
+		if (sg->size < sizeof(M36_CONFIG)) {		/* check buf size */
+			error = ERR_LL_USERBUF;
+			break;
+		}
+
+		/* validate all parameters before touching the hardware */
+		if ((cfgP->enableMask >> llHdl->chNumber) ||
+			(cfgP->bipolar > 1) || (cfgP->extTrig > 1)) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		for (i=0, nbr=0; i<llHdl->chNumber; i++) {
+			if (cfgP->gain[i] > 0x04 /* (M36N) */)
+				error = ERR_LL_ILL_PARAM;
+			nbr += (cfgP->enableMask >> i) & 0x01;
+		}
+		/* irq moderation needs room for more than one scan */
+		if (llHdl->modMode && (BATCH_MAX(llHdl, nbr) == 1))
+			error = ERR_LL_ILL_PARAM;
+		/* frames must not wrap around the buffer end */
+		if (!FrameFits(llHdl, nbr))
+			error = ERR_LL_ILL_PARAM;
+		if (error)
+			break;
+
+		/* staged config */
+		if (llHdl->cfgStage) {
+			/* not torn by a pending commit */
+			irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+			for (i=0; i<llHdl->chNumber; i++) {
+				llHdl->stgEnable[i] = (cfgP->enableMask >> i) & 0x01;
+				llHdl->stgGain[i]   = cfgP->gain[i];
+			}
+			llHdl->stgBipolar = cfgP->bipolar;
+			llHdl->stgExtTrig = cfgP->extTrig;
+			OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+			break;
+		}
+
+		TrigMode(llHdl, cfgP->extTrig);
+
+		/* update channel configuration */
+		llHdl->nbrEnabledCh = 0;
+		for (i=0; i<llHdl->chNumber; i++) {
+			llHdl->enable[i] = (cfgP->enableMask >> i) & 0x01;
+			llHdl->gain[i]   = cfgP->gain[i];
+			llHdl->nbrEnabledCh += llHdl->enable[i];
+		}
+		llHdl->bipolar = cfgP->bipolar;
+
+		/* program the hardware once */
+		InitAllChan(llHdl);
+		break;
+	}
+        /*--------------------------+
+		  | staged configuration    |
+		  +-------------------------*/
+	case M36_CFG_STAGE:
+		if ( (value < 0) || (value > 1) ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		if ( value && !llHdl->cfgStage ) {
+			/* start with the active config */
+			for (i=0; i<llHdl->chNumber; i++) {
+				llHdl->stgEnable[i] = llHdl->enable[i];
+				llHdl->stgGain[i]   = llHdl->gain[i];
+			}
+			llHdl->stgBipolar = llHdl->bipolar;
+			llHdl->stgExtTrig = llHdl->extTrig;
+		}
+		llHdl->cfgStage  = value;
+		llHdl->cfgCommit = 0;		/* discard pending commit */
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+		break;
+        /*--------------------------+
+		  | commit staged config    |
+		  +-------------------------*/
+	case M36_CFG_COMMIT:
+		if ( !llHdl->cfgStage ) {
+			error = ERR_LL_ILL_FUNC;
+			break;
+		}
+		/* frames must not wrap around the buffer end */
+		for (value=0, i=0; i<llHdl->chNumber; i++)
+			value += llHdl->stgEnable[i];
+		if ( !FrameFits(llHdl, value) ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		if ( llHdl->irqEnabled )
+			llHdl->cfgCommit = 1;	/* applied by M36_Irq */
+		else
+			CommitConfig(llHdl);
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+		break;
+        /*--------------------------+
+		  | scan ring               |
+		  +-------------------------*/
+	case M36_RING_WAIT:
+		if ( !llHdl->ringDepth ) {
+			error = ERR_LL_ILL_FUNC;
+			break;
+		}
+		if ( (value < 1) || ((u_int32)value > llHdl->ringDepth) ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		llHdl->ringWait = value;
+		for (i=0; i<llHdl->ringReaders; i++)
+			llHdl->ringBatch[i] = value;	/* restart adaption */
+		break;
+        /*--------------------------+
+		  | finite acquisition      |
+		  +-------------------------*/
+	case M36_ACQ_COUNT:
+		if ( value < 0 ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		llHdl->acqCount = value;
+		llHdl->acqLeft  = value;
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+		break;
+        /*--------------------------+
+		  | acquisition done signal |
+		  +-------------------------*/
+	case M36_ACQ_SIGSET:
+		if ( llHdl->acqSig ) {			/* already installed ? */
+			error = ERR_OSS_SIG_SET;
+			break;
+		}
+		error = OSS_SigCreate(llHdl->osHdl, value, &llHdl->acqSig);
+		break;
+        /*--------------------------+
+		  | remove done signal      |
+		  +-------------------------*/
+	case M36_ACQ_SIGCLR:
+		if ( llHdl->acqSig == NULL ) {	/* not installed ? */
+			error = ERR_OSS_SIG_CLR;
+			break;
+		}
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		sigHdl = llHdl->acqSig;
+		llHdl->acqSig = NULL;			/* M36_Irq must not send */
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+		error = OSS_SigRemove(llHdl->osHdl, &sigHdl);
+		break;
+        /*--------------------------+
+		  | software trigger        |
+		  +-------------------------*/
+	case M36_TRG_CH:
+	case M36_TRG_LEVEL:
+	case M36_TRG_EDGE:
+		if ( !llHdl->trgEnable ) {
+			error = ERR_LL_ILL_FUNC;
+			break;
+		}
+		if ( ((code == M36_TRG_CH) &&
+			  ((u_int32)value >= llHdl->chNumber)) ||
+			 ((code == M36_TRG_LEVEL) && ((u_int32)value > 0xffff)) ||
+			 ((code == M36_TRG_EDGE) && ((u_int32)value > M36_TRG_BELOW)) ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		if ( code == M36_TRG_CH )
+			llHdl->trgCh = value;
+		else if ( code == M36_TRG_LEVEL )
+			llHdl->trgLevel = value;
+		else
+			llHdl->trgEdge = value;
+		llHdl->trgPrevOk = FALSE;		/* no edge across a change */
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+		break;
+        /*--------------------------+
+		  | software-timed sampling |
+		  +-------------------------*/
+	case M36_SW_PERIOD:
+		if ( llHdl->swTimer == NULL ) {	/* SW_TIMER not configured */
+			error = ERR_LL_ILL_FUNC;
+			break;
+		}
+		if ( value && llHdl->irqEnabled ) {	/* interrupt mode */
+			error = ERR_LL_ILL_FUNC;
+			break;
+		}
+		if ( value < 0 ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		if ( llHdl->swPeriod )
+			OSS_TimerStop(llHdl->osHdl, llHdl->swTimer);
+		llHdl->swPeriod = value;
+		if ( value )
+			error = OSS_TimerStart(llHdl->osHdl, llHdl->swTimer,
+								   value, TRUE);
+		if ( error )
+			llHdl->swPeriod = 0;
+		break;
+        /*--------------------------+
+		  | BIN in frame header     |
+		  +-------------------------*/
+	case M36_BIN_SAMPLE:
+		/* one scan per interrupt: not with irq moderation */
+		if ( ((u_int32)value > 1) ||
+			 (value && (!HDR_STORED(llHdl) || llHdl->modMode)) ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		llHdl->binSample = value;		/* used by next irq */
+		break;
+        /*--------------------------+
+		  | gating by binary input  |
+		  +-------------------------*/
+	case M36_GATE_MODE:
+		if ( ((u_int32)value > M36_GATE_LOW) ||
+			 (value && !HDR_STORED(llHdl)) ) {
+			error = ERR_LL_ILL_PARAM;
+			break;
+		}
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		llHdl->gateMode = value;
+		llHdl->gateOpen = FALSE;		/* evaluated by next irq */
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+		break;
 
 /* --- Flash Functions for internal use only! --- */
 
@@ -997,6 +2402,8 @@ static int32 M36_SetStat(
 			error = ERR_LL_UNK_CODE;
     }
 
+	OSS_SemSignal(llHdl->osHdl, lockHdl);
+
 	return(error);
 }
 
@@ -1039,6 +2446,59 @@ static int32 M36_SetStat(
  *                                      0 = differential
  *                                      1 = single ended
  *                M36_NBR_ENABLED_CH    number of enabled channels 0..16
+ *                M36_FRAME_SIZE       size of one scan in the    2..32
+ *                                     input buffer [bytes]
+ *                M36_IRQ_MOD          adaptive irq moderation    0..1
+ *                M36_IRQ_BATCH        current scans per irq      1..16
+ *                M36_BLK_IRQMOD       irq moderation statistics  M36_IRQMOD
+ *                                     (block getstat)
+ *                M36_BLK_STATS        acquisition statistics     M36_STATS
+ *                                     (block getstat)
+ *                M36_BLK_CONFIG       channel configuration      M36_CONFIG
+ *                                     (block getstat)
+ *                M36_CFG_STAGE        staged configuration       0..1
+ *                M36_CFG_COMMIT       commit pending             0..1
+ *                M36_CFG_GEN          configuration generation   0..0xffff
+ *                M36_RING_WAIT        scans to wait for          1..DEPTH
+ *                M36_ACQ_COUNT        finite acquisition         0..max
+ *                                      (0 = continuous)
+ *                M36_ACQ_LEFT         scans still to acquire     0..max
+ *                                      (0 and M36_ACQ_COUNT>0:
+ *                                       acquisition complete)
+ *                M36_TRG_CH           trigger channel            0..15
+ *                M36_TRG_LEVEL        trigger level (raw)        0..0xffff
+ *                M36_TRG_EDGE         trigger condition          0..3
+ *                M36_TRG_WINDOWS      capture windows delivered  0..max
+ *                M36_SW_PERIOD        sw-timed sampling [msec]   0..max
+ *                                      (0 = off/stopped)
+ *                M36_BIN_SAMPLE       BIN into header flags      0..1
+ *                M36_GATE_MODE        gating by binary input     0..2
+ *                M36_GATE_OPEN        gate open at last irq      0..1
+ *                M36_GATE_EDGES       gate edges seen            0..max
+ *                M36_BLK_RING         scan ring state            M36_RING_INFO
+ *                                     (read cursor of curr ch)
+ *                                     (block getstat)
+ *                M36_DEMUX_LEVEL      samples in ring of curr ch 0..DEPTH
+ *                M36_DEMUX_LOST       samples lost of curr ch    0..max
+ *                                     (DEMUX only)
+ *                M36_BLK_BUFQ         buffer queue state         M36_BUFQ_INFO
+ *                                     (block getstat)
+ *                M36_BLK_SNAPSHOT     latest complete scan       M36_SNAPSHOT
+ *                                     (block getstat)
+ *                                      while neither the interrupt
+ *                                      nor the sampling timer is
+ *                                      enabled, the data registers
+ *                                      of the enabled channels are
+ *                                      read (seq=0)
+ *                M36_BLK_READ         deadline bounded read      M36_DLREAD_HDR
+ *                                     (block getstat)             + data
+ *                                      waits max. deadline [msec]
+ *                                      for nbrScans scans, then
+ *                                      returns the whole scans
+ *                                      available (also none)
+ *
+ *                Note: the channel configuration codes always return the
+ *                      active configuration, also if M36_CFG_STAGE=1.
  *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl           ll handle
@@ -1133,8 +2593,10 @@ static int32 M36_GetStat(
 		if (blk->size < MOD_ID_SIZE)		/* check buf size */
 			return(ERR_LL_USERBUF);
 
+		OSS_SemWait(llHdl->osHdl, llHdl->cfgSemHdl, OSS_SEM_WAITINFINITE);
 		for (n=0; n<MOD_ID_SIZE/2; n++)		/* read MOD_ID_SIZE/2 words */
 			*dataP++ = (int16)m_read((U_INT32_OR_64)llHdl->ma, (int8)n);
+		OSS_SemSignal(llHdl->osHdl, llHdl->cfgSemHdl);
 
 		break;
 	}
@@ -1188,64 +2650,362 @@ static int32 M36_GetStat(
 		*valueP = llHdl->nbrEnabledCh;
 		break;
         /*--------------------------+
-		  | Dump Register space     |
-		  +--------------------------*/
-	case M36_REG_DUMP:
-		DBGWRT_2((DBH, "LL - M36_REG_DUMP Dump Registers:"));
-		for ( i = 0; i < 0x100; i +=2 ) {
-			if (!( i % 0x10))
-				DBGWRT_2((DBH, "\n  0x%02x ", i));
-			DBGWRT_2((DBH, "%04x ", MREAD_D16(llHdl->ma, i)));
-		}
-		*valueP = 0;
+		  | frame size in buffer    |
+		  +-------------------------*/
+	case M36_FRAME_SIZE:
+		*valueP = llHdl->frameWords * CH_BYTES;
 		break;
-
-
-		/* ---	For MEN internal use only --- */
-
-		/*-------------------------+
-		 | Flash Block Read        |
-		 +-------------------------*/
-	case M36_BLK_FLASH:
-		dataP 	= (u_int16*)blk->data;
-		for ( i = 0; i < 0x800; i += 2 )
-			*dataP++=(u_int16)M36_FlashRead(llHdl, 0xff800 + i);
+        /*--------------------------+
+		  | irq moderation          |
+		  +-------------------------*/
+	case M36_IRQ_MOD:
+		*valueP = llHdl->modMode;
 		break;
-
         /*--------------------------+
-		 | Get 18bit raw ADC values |
-		 +--------------------------*/
-	case M36_GET_RAWDAT:
-		do {
-			/*
-			 * FPGA writes the 18bit raw data Registers in swapped manner
-			 * ( compared to all other registers )
-			 */
-			hi1 = OSS_Swap16(MREAD_D16( llHdl->ma, (ch*4) + 0x82 ));
-			lo1 = OSS_Swap16(MREAD_D16( llHdl->ma, (ch*4) + 0x80 ));
-			hi2 = OSS_Swap16(MREAD_D16( llHdl->ma, (ch*4) + 0x82 ));
-			lo2 = OSS_Swap16(MREAD_D16( llHdl->ma, (ch*4) + 0x80 ));
+		  | scans per interrupt     |
+		  +-------------------------*/
+	case M36_IRQ_BATCH:
+		*valueP = llHdl->batch;
+		break;
+        /*--------------------------+
+		  | staged configuration    |
+		  +-------------------------*/
+	case M36_CFG_STAGE:
+		*valueP = llHdl->cfgStage;
+		break;
+        /*--------------------------+
+		  | commit pending          |
+		  +-------------------------*/
+	case M36_CFG_COMMIT:
+		*valueP = llHdl->cfgCommit;
+		break;
+        /*--------------------------+
+		  | config generation       |
+		  +-------------------------*/
+	case M36_CFG_GEN:
+		*valueP = llHdl->cfgGen;
+		break;
+        /*--------------------------+
+		  | scan ring wakeup        |
+		  +-------------------------*/
+	case M36_RING_WAIT:
+		*valueP = llHdl->ringWait;
+		break;
+        /*--------------------------+
+		  | finite acquisition      |
+		  +-------------------------*/
+	case M36_ACQ_COUNT:
+		*valueP = llHdl->acqCount;
+		break;
+        /*--------------------------+
+		  | scans left to acquire   |
+		  +-------------------------*/
+	case M36_ACQ_LEFT:
+		*valueP = llHdl->acqLeft;
+		break;
+        /*--------------------------+
+		  | trigger channel         |
+		  +-------------------------*/
+	case M36_TRG_CH:
+		*valueP = llHdl->trgCh;
+		break;
+        /*--------------------------+
+		  | trigger level           |
+		  +-------------------------*/
+	case M36_TRG_LEVEL:
+		*valueP = llHdl->trgLevel;
+		break;
+        /*--------------------------+
+		  | trigger edge            |
+		  +-------------------------*/
+	case M36_TRG_EDGE:
+		*valueP = llHdl->trgEdge;
+		break;
+        /*--------------------------+
+		  | trigger windows         |
+		  +-------------------------*/
+	case M36_TRG_WINDOWS:
+		*valueP = llHdl->trgWindows;
+		break;
+        /*--------------------------+
+		  | software-timed sampling |
+		  +-------------------------*/
+	case M36_SW_PERIOD:
+		*valueP = llHdl->swPeriod;
+		break;
+        /*--------------------------+
+		  | BIN in frame header     |
+		  +-------------------------*/
+	case M36_BIN_SAMPLE:
+		*valueP = llHdl->binSample;
+		break;
+        /*--------------------------+
+		  | gating by binary input  |
+		  +-------------------------*/
+	case M36_GATE_MODE:
+		*valueP = llHdl->gateMode;
+		break;
+        /*--------------------------+
+		  | gate state              |
+		  +-------------------------*/
+	case M36_GATE_OPEN:
+		*valueP = llHdl->gateOpen;
+		break;
+        /*--------------------------+
+		  | gate edges seen         |
+		  +-------------------------*/
+	case M36_GATE_EDGES:
+		*valueP = llHdl->gateEdges;
+		break;
+        /*--------------------------+
+		  | scan ring state         |
+		  +-------------------------*/
+	case M36_BLK_RING:
+	{
+		M36_RING_INFO *infoP = (M36_RING_INFO*)blk->data;
 
-		} while((lo1 != lo2) || (hi1 != hi2)); /* stable data? */
+		if (blk->size < sizeof(M36_RING_INFO))	/* check buf size */
+			return(ERR_LL_USERBUF);
 
-		hi = ((hi1 << 8) & 0xff00 ) | ((hi1 >> 8) & 0xff );
-		lo = ((lo1 << 8) & 0xff00 ) | ((lo1 >> 8) & 0xff );
+		if ((u_int32)ch >= llHdl->ringReaders)	/* cursor of channel */
+			return(ERR_LL_ILL_CHAN);
 
-		if (hi & 0x2) /* fill sign 18bit up to become a 32bit int */
-			hi |=0xfffc;
-		else
-			hi &=0x0001;
+		infoP->depth     = llHdl->ringDepth;
+		infoP->slotSize  = RING_SLOT_WORDS * CH_BYTES;
+		infoP->head      = llHdl->ringHead;
+		infoP->tail      = llHdl->ringTail[ch];
+		infoP->lost      = llHdl->ringLost[ch];
+		infoP->wait      = llHdl->ringWait;
+		infoP->readers   = llHdl->ringReaders;
+		infoP->highwater = llHdl->ringHighwater[ch];
+		infoP->batch     = llHdl->ringBatch[ch];
 
-		longval = (hi << 16) | lo;
-		*valueP = longval;
+		blk->size = sizeof(M36_RING_INFO);
 		break;
-
+	}
         /*--------------------------+
-		 |  MBUF + unknown          |
-		 +--------------------------*/
-	default:
-		if (M_BUF_CODE(code))
+		  | channel ring level      |
+		  +-------------------------*/
+	case M36_DEMUX_LEVEL:
+		*valueP = llHdl->demuxHead[ch] - llHdl->demuxTail[ch];
+		break;
+        /*--------------------------+
+		  | channel ring losses     |
+		  +-------------------------*/
+	case M36_DEMUX_LOST:
+		*valueP = llHdl->demuxLost[ch];
+		break;
+        /*--------------------------+
+		  | buffer queue            |
+		  +-------------------------*/
+	case M36_BLK_BUFQ:
+	{
+		M36_BUFQ_INFO *infoP = (M36_BUFQ_INFO*)blk->data;
+
+		if (blk->size < sizeof(M36_BUFQ_INFO))	/* check buf size */
+			return(ERR_LL_USERBUF);
+
+		infoP->num  = llHdl->bufqNum;
+		infoP->size = llHdl->bufqSize;
+		infoP->done = llHdl->bufqHead - llHdl->bufqTail;
+		infoP->lost = llHdl->bufqLost;
+
+		blk->size = sizeof(M36_BUFQ_INFO);
+		break;
+	}
+        /*--------------------------+
+		  | deadline bounded read   |
+		  +-------------------------*/
+	case M36_BLK_READ:
+	{
+		M36_DLREAD_HDR *dlP = (M36_DLREAD_HDR*)blk->data;
+
+		if (blk->size < sizeof(M36_DLREAD_HDR))	/* check buf size */
+			return(ERR_LL_USERBUF);
+
+		OSS_SemWait(llHdl->osHdl, llHdl->rdSemHdl, OSS_SEM_WAITINFINITE);
+		error = DeadlineRead(llHdl, ch, dlP,
+							 (int32)(blk->size - sizeof(M36_DLREAD_HDR)));
+		OSS_SemSignal(llHdl->osHdl, llHdl->rdSemHdl);
+
+		if (error == ERR_SUCCESS)
+			blk->size = sizeof(M36_DLREAD_HDR) + dlP->size;
+		break;
+	}
+        /*--------------------------+
+		  | latest complete scan    |
+		  +-------------------------*/
+	case M36_BLK_SNAPSHOT:
+	{
+		M36_SNAPSHOT *snapP = (M36_SNAPSHOT*)blk->data;
+
+		if (blk->size < sizeof(M36_SNAPSHOT))	/* check buf size */
+			return(ERR_LL_USERBUF);
+
+		if (!(llHdl->irqEnabled || llHdl->swPeriod) ||
+			ScanLatest(llHdl, snapP)) {
+			/* no acquisition: read data registers (config lock) */
+			OSS_SemWait(llHdl->osHdl, llHdl->cfgSemHdl, OSS_SEM_WAITINFINITE);
+			snapP->seq    = 0;
+			snapP->stamp  = M36_TIMESTAMP(llHdl);
+			snapP->chMask = llHdl->chMask;
+			snapP->cfgGen = llHdl->cfgGen;
+			for (i=0; i<CH_NUMBER_SINGLE; i++) {
+				if ((i < llHdl->chNumber) && llHdl->enable[i])
+					snapP->data[i] = MREAD_D16(llHdl->ma, llHdl->dataReg[i]);
+				else
+					snapP->data[i] = 0;
+			}
+			OSS_SemSignal(llHdl->osHdl, llHdl->cfgSemHdl);
+		}
+
+		blk->size = sizeof(M36_SNAPSHOT);
+		break;
+	}
+        /*--------------------------+
+		  | irq moderation state    |
+		  +-------------------------*/
+	case M36_BLK_IRQMOD:
+	{
+		M36_IRQMOD *modP = (M36_IRQMOD*)blk->data;
+		OSS_IRQ_STATE irqState;
+
+		if (blk->size < sizeof(M36_IRQMOD))		/* check buf size */
+			return(ERR_LL_USERBUF);
+
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		modP->mode        = llHdl->modMode;
+		modP->batch       = llHdl->batch;
+		modP->rateHigh    = llHdl->modRateHigh;
+		modP->rateLow     = llHdl->modRateLow;
+		modP->toBatch     = llHdl->modToBatch;
+		modP->toSingle    = llHdl->modToSingle;
+		modP->ticksSingle = llHdl->modTicks[0];
+		modP->ticksBatch  = llHdl->modTicks[1];
+		/* add current window */
+		if (llHdl->batch > 1)
+			modP->ticksBatch  += OSS_TickGet(llHdl->osHdl) - llHdl->modWinStart;
+		else
+			modP->ticksSingle += OSS_TickGet(llHdl->osHdl) - llHdl->modWinStart;
+		modP->tickRate    = llHdl->tickRate;
+		modP->batchMax    = llHdl->batchMax;
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+		blk->size = sizeof(M36_IRQMOD);
+		break;
+	}
+        /*--------------------------+
+		  | acquisition statistics  |
+		  +-------------------------*/
+	case M36_BLK_STATS:
+	{
+		M36_STATS *statP = (M36_STATS*)blk->data;
+		OSS_IRQ_STATE irqState;
+
+		if (blk->size < sizeof(M36_STATS))		/* check buf size */
+			return(ERR_LL_USERBUF);
+
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		statP->irqs       = llHdl->irqCount;
+		statP->scans      = llHdl->statScans;
+		statP->dropped    = llHdl->statDropped;
+		statP->wrapFail   = llHdl->statWrapFail;
+		statP->dfrLost    = llHdl->dfrLost;
+		statP->levelMax   = llHdl->bufLevelMax;
+		statP->irqTimeMax = llHdl->irqTimeMax;
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+		blk->size = sizeof(M36_STATS);
+		break;
+	}
+        /*--------------------------+
+		  | channel configuration   |
+		  +-------------------------*/
+	case M36_BLK_CONFIG:
+	{
+		M36_CONFIG *cfgP = (M36_CONFIG*)blk->data;
+
+		if (blk->size < sizeof(M36_CONFIG))		/* check buf size */
+			return(ERR_LL_USERBUF);
+
+		OSS_SemWait(llHdl->osHdl, llHdl->cfgSemHdl, OSS_SEM_WAITINFINITE);
+		cfgP->enableMask = 0;
+		for (i=0; i<CH_NUMBER_SINGLE; i++) {
+			if ((i < llHdl->chNumber) && llHdl->enable[i])
+				cfgP->enableMask |= 1 << i;
+			cfgP->gain[i] = (i < llHdl->chNumber) ? llHdl->gain[i] : 0;
+		}
+		cfgP->bipolar = llHdl->bipolar;
+		cfgP->extTrig = llHdl->extTrig;
+		OSS_SemSignal(llHdl->osHdl, llHdl->cfgSemHdl);
+
+		blk->size = sizeof(M36_CONFIG);
+		break;
+	}
+        /*--------------------------+
+		  | Dump Register space     |
+		  +--------------------------*/
+	case M36_REG_DUMP:
+		DBGWRT_2((DBH, "LL - M36_REG_DUMP Dump Registers:"));
+		for ( i = 0; i < 0x100; i +=2 ) {
+			if (!( i % 0x10))
+				DBGWRT_2((DBH, "\n  0x%02x ", i));
+			DBGWRT_2((DBH, "%04x ", MREAD_D16(llHdl->ma, i)));
+		}
+		*valueP = 0;
+		break;
+
+
+		/* ---	For MEN internal use only --- */
+
+		/*-------------------------+
+		 | Flash Block Read        |
+		 +-------------------------*/
+	case M36_BLK_FLASH:
+		dataP 	= (u_int16*)blk->data;
+		OSS_SemWait(llHdl->osHdl, llHdl->cfgSemHdl, OSS_SEM_WAITINFINITE);
+		for ( i = 0; i < 0x800; i += 2 )
+			*dataP++=(u_int16)M36_FlashRead(llHdl, 0xff800 + i);
+		OSS_SemSignal(llHdl->osHdl, llHdl->cfgSemHdl);
+		break;
+
+        /*--------------------------+
+		 | Get 18bit raw ADC values |
+		 +--------------------------*/
+	case M36_GET_RAWDAT:
+		do {
+			/*
+			 * FPGA writes the 18bit raw data Registers in swapped manner
+			 * ( compared to all other registers )
+			 */
+			hi1 = OSS_Swap16(MREAD_D16( llHdl->ma, (ch*4) + 0x82 ));
+			lo1 = OSS_Swap16(MREAD_D16( llHdl->ma, (ch*4) + 0x80 ));
+			hi2 = OSS_Swap16(MREAD_D16( llHdl->ma, (ch*4) + 0x82 ));
+			lo2 = OSS_Swap16(MREAD_D16( llHdl->ma, (ch*4) + 0x80 ));
+
+		} while((lo1 != lo2) || (hi1 != hi2)); /* stable data? */
+
+		hi = ((hi1 << 8) & 0xff00 ) | ((hi1 >> 8) & 0xff );
+		lo = ((lo1 << 8) & 0xff00 ) | ((lo1 >> 8) & 0xff );
+
+		if (hi & 0x2) /* fill sign 18bit up to become a 32bit int */
+			hi |=0xfffc;
+		else
+			hi &=0x0001;
+
+		longval = (hi << 16) | lo;
+		*valueP = longval;
+		break;
+
+        /*--------------------------+
+		 |  MBUF + unknown          |
+		 +--------------------------*/
+	default:
+		if (M_BUF_CODE(code)) {
+			OSS_SemWait(llHdl->osHdl, llHdl->rdSemHdl, OSS_SEM_WAITINFINITE);
 			error = MBUF_GetStat(llHdl->bufHdl, NULL, code, valueP);
+			OSS_SemSignal(llHdl->osHdl, llHdl->rdSemHdl);
+		}
 		else
 			error = ERR_LL_UNK_CODE;
     }
@@ -1295,9 +3055,20 @@ static int32 M36_GetStat(
  *                of bytes from the input buffer to the given data buffer.
  *                The interrupt of the carrier board must be enabled for
  *                buffered input modes. (see also function M36_Irq)
+ *                With IRQ_DEFER/ENABLE=1, scans reach the input buffer
+ *                with up to one IRQ_DEFER/PERIOD delay (bottom half timer).
  *
  *                For details on buffered input modes refer to the MDIS-Doc.
  *
+ *                Driver Rings
+ *                ------------
+ *                Instead of the input buffer, the data is read from
+ *                - the driver scan ring (SCAN_RING/DEPTH>0): whole slots
+ *                  (read cursor of the current channel)
+ *                - the buffer queue (BUF_QUEUE/NUM>0): one buffer
+ *                - the channel ring of the current channel
+ *                  (DEMUX/DEPTH>0): contiguous samples of ch only
+ *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl        ll handle
  *                ch           current channel
@@ -1316,12 +3087,60 @@ static int32 M36_BlockRead(
 )
 {
 	u_int16 *bufP = (u_int16*)buf;
-    u_int32 n;
-	int32 bufMode;
 	int32 error;
 
     DBGWRT_1((DBH, "LL - M36_BlockRead: ch=%d, size=%d\n",ch,size));
 
+	OSS_SemWait(llHdl->osHdl, llHdl->rdSemHdl, OSS_SEM_WAITINFINITE);
+
+	/* driver scan ring */
+	if (llHdl->ringDepth)
+		error = RingRead(llHdl, ch, bufP, size, 0, 0, nbrRdBytesP);
+
+	/* buffer queue */
+	else if (llHdl->bufqNum)
+		error = BufqRead(llHdl, bufP, size, nbrRdBytesP);
+
+	/* channel ring of current channel */
+	else if (llHdl->demuxDepth)
+		error = DemuxRead(llHdl, ch, bufP, size, nbrRdBytesP);
+
+	/* input buffer or hardware */
+	else
+		error = InBufRead(llHdl, bufP, size, nbrRdBytesP);
+
+	OSS_SemSignal(llHdl->osHdl, llHdl->rdSemHdl);
+
+	return(error);
+}
+
+/******************************* InBufRead **********************************
+ *
+ *  Description:  Read from input buffer or hardware (M_BUF_USRCTRL)
+ *
+ *                Called with the read lock held. In M_BUF_USRCTRL mode
+ *                the scan is read with the irq masked, so it is not
+ *                mixed with a channel reconfiguration.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl        ll handle
+ *                bufP         data buffer
+ *                size         data buffer size in bytes
+ *  Output.....:  nbrRdBytesP  number of read bytes
+ *                return       success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 InBufRead(	/* nodoc */
+	LL_HANDLE *llHdl,
+	u_int16   *bufP,
+	int32     size,
+	int32     *nbrRdBytesP
+)
+{
+	OSS_IRQ_STATE irqState;
+	int32 bufMode;
+	int32 error;
+
 	/* get current buffer mode */
 	if ((error = MBUF_GetBufferMode(llHdl->bufHdl, &bufMode)))
 		return(error);
@@ -1331,19 +3150,19 @@ static int32 M36_BlockRead(
 	+-------------------------*/
 	if (bufMode == M_BUF_USRCTRL) {
 		/* check if any channel to read */
-		if (llHdl->nbrEnabledCh == 0)
+		if (llHdl->scanNbr == 0)
 			return(ERR_LL_READ);
 
 		/* check size */
-		if (size < (CH_BYTES * llHdl->nbrEnabledCh))
+		if (size < (CH_BYTES * llHdl->scanNbr))
 			return(ERR_LL_USERBUF);
 
-		/* read all enabled channels */
-		for (n=0; n<llHdl->chNumber; n++)
-			if (llHdl->enable[n])
-				*bufP++ = MREAD_D16(llHdl->ma, llHdl->dataReg[n]);
+		/* read all enabled channels (scan plan) */
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		ReadScan(llHdl, bufP, 0, llHdl->scanNbr);
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
 
-		*nbrRdBytesP = (int32)( (INT32_OR_64)bufP - (INT32_OR_64)buf );
+		*nbrRdBytesP = CH_BYTES * llHdl->scanNbr;
 	}
 
 	/*-------------------------+
@@ -1351,14 +3170,240 @@ static int32 M36_BlockRead(
 	+-------------------------*/
 	else {
 		/* read from buffer */
-		if ((error = MBUF_Read(llHdl->bufHdl,
-							   (u_int8*)bufP, size, nbrRdBytesP)))
+		if ((error = BufRead(llHdl, bufP, size, nbrRdBytesP)))
 			return(error);
 	}
 
 	return(ERR_SUCCESS);
 }
 
+/******************************* BufRead ************************************
+ *
+ *  Description:  Read from input buffer and update the fill level
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl        ll handle
+ *                bufP         data buffer
+ *                size         data buffer size in bytes
+ *  Output.....:  nbrRdBytesP  number of read bytes
+ *                return       success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 BufRead(	/* nodoc */
+	LL_HANDLE *llHdl,
+	u_int16   *bufP,
+	int32     size,
+	int32     *nbrRdBytesP
+)
+{
+	OSS_IRQ_STATE irqState;
+	int32 error;
+
+	if ((error = MBUF_Read(llHdl->bufHdl, (u_int8*)bufP, size, nbrRdBytesP)))
+		return(error);
+
+	/* update fill level (statistics, M36_BLK_READ) */
+	irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+	if (llHdl->bufLevel > (u_int32)*nbrRdBytesP)
+		llHdl->bufLevel -= *nbrRdBytesP;
+	else
+		llHdl->bufLevel = 0;
+	OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+	return(ERR_SUCCESS);
+}
+
+/******************************* DeadlineRead *******************************
+ *
+ *  Description:  Deadline bounded read (M36_BLK_READ)
+ *
+ *                Waits max. dlP->deadline [msec] until dlP->nbrScans
+ *                scans (0 = as many as fit) are available, then returns
+ *                the whole scans available, which may be less or none.
+ *                The data (frames of the input buffer or slots of the
+ *                scan ring) follows the header. Called with the read
+ *                lock held.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl     ll handle
+ *                ch        current channel (scan ring cursor)
+ *                dlP       header: deadline, nbrScans
+ *                size      data size following the header [bytes]
+ *  Output.....:  dlP       header: nbrScans, size
+ *                return    success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 DeadlineRead(	/* nodoc */
+	LL_HANDLE      *llHdl,
+	int32          ch,
+	M36_DLREAD_HDR *dlP,
+	int32          size
+)
+{
+	u_int16 *dataP = (u_int16*)(dlP + 1);
+	u_int32 unitBytes;
+	int32 nbrRd = 0;
+	int32 error;
+
+	if (dlP->deadline == 0)
+		return(ERR_LL_ILL_PARAM);
+
+	/* driver scan ring: whole slots */
+	if (llHdl->ringDepth) {
+		unitBytes = RING_SLOT_WORDS * CH_BYTES;
+		error = RingRead(llHdl, ch, dataP, size, dlP->nbrScans,
+						 dlP->deadline, &nbrRd);
+	}
+	/* buffer queue/channel rings: not supported */
+	else if (llHdl->bufqNum || llHdl->demuxDepth)
+		return(ERR_LL_ILL_FUNC);
+
+	/* input buffer: whole frames */
+	else {
+		unitBytes = llHdl->frameWords * CH_BYTES;
+		error = InBufDeadline(llHdl, dataP, size, dlP->nbrScans,
+							  dlP->deadline, &nbrRd);
+	}
+
+	if (error)
+		return(error);
+
+	dlP->nbrScans = (u_int32)nbrRd / unitBytes;
+	dlP->size     = (u_int32)nbrRd;
+
+	return(ERR_SUCCESS);
+}
+
+/******************************* InBufDeadline ******************************
+ *
+ *  Description:  Deadline bounded read of whole frames from input buffer
+ *
+ *                Only for the M_BUF_RINGBUF(_OVERWR) modes. Waits until
+ *                want frames are stored (signalled by StoreFrame) or the
+ *                deadline passed, then reads the whole frames available
+ *                (MBUF_Read does not block then).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl        ll handle
+ *                bufP         data buffer
+ *                size         data buffer size in bytes
+ *                want         frames to wait for (0 = as many as fit)
+ *                deadline     max. wait [msec]
+ *  Output.....:  nbrRdBytesP  number of read bytes
+ *                return       success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 InBufDeadline(	/* nodoc */
+	LL_HANDLE *llHdl,
+	u_int16   *bufP,
+	int32     size,
+	u_int32   want,
+	u_int32   deadline,
+	int32     *nbrRdBytesP
+)
+{
+	OSS_IRQ_STATE irqState;
+	u_int32 frameBytes = llHdl->frameWords * CH_BYTES;
+	u_int32 startTick  = OSS_TickGet(llHdl->osHdl);
+	u_int32 maxFrames, level;
+	int32 bufMode, tout;
+	int32 error;
+
+	*nbrRdBytesP = 0;
+
+	if ((error = MBUF_GetBufferMode(llHdl->bufHdl, &bufMode)))
+		return(error);
+
+	if ((bufMode != M_BUF_RINGBUF) && (bufMode != M_BUF_RINGBUF_OVERWR))
+		return(ERR_LL_ILL_FUNC);
+
+	if (frameBytes == 0)
+		return(ERR_LL_READ);
+
+	if ((maxFrames = (u_int32)size / frameBytes) == 0)
+		return(ERR_LL_USERBUF);
+
+	if ((want == 0) || (want > maxFrames))
+		want = maxFrames;
+
+	/* wait for frames */
+	for (;;) {
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		level = llHdl->bufLevel;
+		llHdl->dlWaitBytes = (level < want * frameBytes) ?
+			want * frameBytes : 0;
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+		if (level >= want * frameBytes)
+			break;
+
+		tout  = TimeLeft(llHdl, startTick, deadline);
+		error = tout ? WaitSem(llHdl, llHdl->dlSem, tout) : ERR_OSS_TIMEOUT;
+
+		if (error == ERR_OSS_TIMEOUT) {
+			want = 0;		/* deadline passed: take what is there */
+			continue;
+		}
+
+		if (error) {
+			llHdl->dlWaitBytes = 0;
+			return(error);
+		}
+	}
+
+	/* read whole frames */
+	level /= frameBytes;
+	if (level > maxFrames)
+		level = maxFrames;
+
+	if (level == 0)
+		return(ERR_SUCCESS);
+
+	return( BufRead(llHdl, bufP, (int32)(level * frameBytes), nbrRdBytesP) );
+}
+
+/******************************* TimeLeft ***********************************
+ *
+ *  Description:  Remaining time until a deadline
+ *
+ *                Compared in ticks, so long waits or high tick rates do
+ *                not overflow.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		 ll handle
+ *                startTick  OSS tick at start
+ *                msec       deadline relative to start [msec]
+ *  Output.....:  return     remaining time [msec] (0 = passed)
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 TimeLeft(	/* nodoc */
+	LL_HANDLE *llHdl,
+	u_int32   startTick,
+	u_int32   msec
+)
+{
+	u_int32 rate = llHdl->tickRate;
+	u_int32 ticks, elapsed, left;
+
+	/* deadline in ticks (divide first: no overflow) */
+	if (msec / 1000 > 0xffffffff / rate)
+		ticks = 0xffffffff;
+	else
+		ticks = (msec / 1000) * rate + (msec % 1000) * rate / 1000;
+
+	elapsed = OSS_TickGet(llHdl->osHdl) - startTick;
+	if (elapsed >= ticks)
+		return(0);
+
+	/* remaining ticks in msec, at least 1 until passed */
+	ticks -= elapsed;
+	left = (ticks / rate) * 1000 + (ticks % rate) * 1000 / rate;
+	if (left > 0x7fffffff)
+		left = 0x7fffffff;
+
+	return( left ? (int32)left : 1 );
+}
+
 /****************************** M36_BlockWrite *******************************
  *
  *  Description:  Write data block to device
@@ -1402,7 +3447,9 @@ static int32 M36_BlockWrite(	/* nodoc */
  *
  *                If an input buffer is used, all input channels, which
  *                are enabled for block i/o are stored in ascending order
- *                in the input buffer:
+ *                in the input buffer (with IN_BUF/FRAME_HEADER, preceded
+ *                by a M36_FRAME_HDR, with IN_BUF/FRAME_ALIGN, followed
+ *                by zero words up to the frame size):
  *
  *                   +---------+
  *                   |  word 0 |  first enabled input channel
@@ -1414,6 +3461,33 @@ static int32 M36_BlockWrite(	/* nodoc */
  *                   |  word k |  last enabled input channel
  *                   +---------+
  *
+ *                With IRQ_DEFER/ENABLE=1 the function only copies the
+ *                data registers into the deferred ring (top half), the
+ *                input buffer is filled by the bottom half (DeferDrain).
+ *
+ *                With adaptive irq moderation, one interrupt may deliver
+ *                a batch of scans (see IrqModerate).
+ *
+ *                After a finite acquisition (M36_ACQ_COUNT) completed,
+ *                the interrupt is only acknowledged. The module has no
+ *                interrupt enable bit, it keeps sampling.
+ *
+ *                A committed staged configuration (M36_CFG_COMMIT) is
+ *                applied after the scans of the old configuration were
+ *                delivered. The next scan is mixed and therefore skipped.
+ *
+ *                With BIN_SAMPLE=1, the binary input of the status
+ *                register is stored in the frame header of the scans.
+ *
+ *                With GATE/MODE>0, the binary input of the status
+ *                register decides if the scans of this interrupt are
+ *                stored (gate open) or discarded (see DeliverScan).
+ *
+ *                The IRQ bit of the status register is checked first.
+ *                If the module did not raise the interrupt (shared line),
+ *                LL_IRQ_DEV_NOT is returned without touching the module
+ *                or the buffer.
+ *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl    ll handle
  *  Output.....:  return   LL_IRQ_DEVICE	irq caused from device
@@ -1425,62 +3499,73 @@ static int32 M36_Irq(
    LL_HANDLE *llHdl
 )
 {
-	u_int16 *bufP;
-	int32	got;
-	u_int32	ch;
-	int32	nbrRdCh = 0;	/* number of read channels */
-	int32	nbrOfBlocks;
+	u_int16 hw[CH_NUMBER_SINGLE];	/* batch of scans */
+	u_int16 stat;
+	u_int32 b;
+	u_int32 dur;
+
+	/*----------------------+
+	| irq from this module? |
+	+----------------------*/
+	stat = MREAD_D16(llHdl->ma, STAT_REG);
+
+	if( stat & IRQ )			/* IRQ bit is low active */
+		return(LL_IRQ_DEV_NOT);
 
     IDBGWRT_1((DBH, "LL - M36_Irq:\n"));
 
+	llHdl->irqStamp = M36_TIMESTAMP( llHdl );
+
+	/* binary input: header flag, gate */
+	ScanStatus( llHdl, stat );
+
 	/*----------------------+
 	| reset irq             |
 	+----------------------*/
-	MSETMASK_D16(llHdl->ma, CTRL_REG, RST);
+	MWRITE_D16(llHdl->ma, CTRL_REG, llHdl->ctrlShadow | RST);
 
 	/*----------------------+
-	| fill buffer           |
+	| deliver scan(s)       |
 	+----------------------*/
-	/* get buffer ptr - check for overrun ? */
-	if( (bufP = (u_int16*)MBUF_GetNextBuf(llHdl->bufHdl,
-							llHdl->nbrEnabledCh, &got)) != 0 ) {
+	/* data elements just reprogrammed: scan not consistent */
+	if( llHdl->scanSkip )
+		llHdl->scanSkip--;
 
-		/* for all channels */
-		for( ch=0; ch<llHdl->chNumber; ch++ ) {
+	/* finite acquisition complete: scans are ignored */
+	else if( llHdl->acqCount && (llHdl->acqLeft == 0) )
+		;
 
-			/* read enabled channel */
-			if( llHdl->enable[ch] ) {
+	/* batch of scans per interrupt (contiguous data elements) */
+	else if( llHdl->batch > 1 ) {
+		MBLOCK_READ_D16(llHdl->ma, DATA_REG(0),
+						llHdl->batch * llHdl->scanNbr * CH_BYTES, hw);
 
-				/* fill buffer entry */
-				*bufP++ = MREAD_D16(llHdl->ma, llHdl->dataReg[ch]);
-				nbrRdCh++;
+		for( b=0; b<llHdl->batch; b++ )
+			DeliverScan( llHdl, &hw[b * llHdl->scanNbr] );
+	}
 
-				if( (nbrRdCh < llHdl->nbrEnabledCh)	/* read another channel ? */
-					&& (nbrRdCh == got) ) {			/* got space full ? */
+	/* one scan per interrupt */
+	else
+		DeliverScan( llHdl, NULL );
 
-					/* calculate missing buffer space */
-					nbrOfBlocks = llHdl->nbrEnabledCh - nbrRdCh;
+	llHdl->irqCount++;
 
-					/* get missing buffer space - wrap around buffer */
-					if( (bufP = (u_int16*)MBUF_GetNextBuf(llHdl->bufHdl,
-											nbrOfBlocks, &got)) == 0 ) {
-						/* wrap around failed */
-						IDBGWRT_ERR((DBH,
-									 "*** LL - M36_Irq: wrap around failed\n"));
-						break;
-					}
-					IDBGWRT_3((DBH,
-						 "LL - M36_Irq: nbrRdCh=%d, nbrOfBlocks=%d, got=%d\n",
-						nbrRdCh,nbrOfBlocks,got));
-				}
-			}
-		} /*for*/
+	/* apply committed config between two scans */
+	if( llHdl->cfgCommit ) {
+		CommitConfig( llHdl );
+		llHdl->scanSkip = 1;	/* next scan started with old config */
+	}
 
-        MBUF_ReadyBuf( llHdl->bufHdl );  /* blockread ready */
-    }
-	llHdl->irqCount++;
+	/* adaptive irq moderation */
+	if( llHdl->modMode )
+		IrqModerate( llHdl );
 
-	return(LL_IRQ_UNKNOWN);		/* say: unknown */
+	/* longest irq duration */
+	dur = M36_TIMESTAMP( llHdl ) - llHdl->irqStamp;
+	if( dur > llHdl->irqTimeMax )
+		llHdl->irqTimeMax = dur;
+
+	return(LL_IRQ_DEVICE);
 }
 
 /****************************** M36_Info ************************************
@@ -1594,7 +3679,7 @@ static int32 M36_Info(
 		{
 			u_int32 *lockModeP = va_arg(argptr, u_int32*);
 
-			*lockModeP = LL_LOCK_CALL;
+			*lockModeP = LL_LOCK_NONE;		/* own locks */
 			break;
 	    }
 		/*-------------------------------+
@@ -1638,6 +3723,8 @@ static int32 Cleanup(	/* nodoc */
    int32        retCode
 )
 {
+	int32 ch;
+
     /*------------------------------+
     |  close handles                |
     +------------------------------*/
@@ -1645,10 +3732,68 @@ static int32 Cleanup(	/* nodoc */
 	if (llHdl->descHdl)
 		DESC_Exit(&llHdl->descHdl);
 
+	/* clean up locks */
+	if (llHdl->rdSemHdl)
+		OSS_SemRemove(llHdl->osHdl, &llHdl->rdSemHdl);
+
+	if (llHdl->cfgSemHdl)
+		OSS_SemRemove(llHdl->osHdl, &llHdl->cfgSemHdl);
+
+	if (llHdl->dlSem)
+		OSS_SemRemove(llHdl->osHdl, &llHdl->dlSem);
+
+	/* clean up completion signal */
+	if (llHdl->acqSig)
+		OSS_SigRemove(llHdl->osHdl, &llHdl->acqSig);
+
+	/* clean up sampling timer */
+	if (llHdl->swTimer) {
+		OSS_TimerStop(llHdl->osHdl, llHdl->swTimer);
+		OSS_TimerRemove(llHdl->osHdl, &llHdl->swTimer);
+	}
+
+	/* clean up bottom half timer */
+	if (llHdl->dfrTimer) {
+		OSS_TimerStop(llHdl->osHdl, llHdl->dfrTimer);
+		OSS_TimerRemove(llHdl->osHdl, &llHdl->dfrTimer);
+	}
+
 	/* clean up buffer */
 	if (llHdl->bufHdl)
 		MBUF_Remove(&llHdl->bufHdl);
 
+	/* clean up deferred irq ring */
+	if (llHdl->dfrRing)
+		OSS_MemFree(llHdl->osHdl, (int8*)llHdl->dfrRing, llHdl->dfrRingSize);
+
+	/* clean up scan ring */
+	for (ch=0; ch<CH_NUMBER_SINGLE; ch++)
+		if (llHdl->ringSem[ch])
+			OSS_SemRemove(llHdl->osHdl, &llHdl->ringSem[ch]);
+
+	if (llHdl->ring)
+		OSS_MemFree(llHdl->osHdl, (int8*)llHdl->ring, llHdl->ringSize);
+
+	/* clean up buffer queue */
+	if (llHdl->bufqSem)
+		OSS_SemRemove(llHdl->osHdl, &llHdl->bufqSem);
+
+	if (llHdl->bufq)
+		OSS_MemFree(llHdl->osHdl, (int8*)llHdl->bufq, llHdl->bufqAlloc);
+
+	/* clean up channel rings */
+	for (ch=0; ch<CH_NUMBER_SINGLE; ch++)
+		if (llHdl->demuxSem[ch])
+			OSS_SemRemove(llHdl->osHdl, &llHdl->demuxSem[ch]);
+
+	if (llHdl->demux)
+		OSS_MemFree(llHdl->osHdl, (int8*)llHdl->demux, llHdl->demuxAlloc);
+
+	/* clean up trigger history */
+	if (llHdl->trgHist)
+		OSS_MemFree(llHdl->osHdl, (int8*)llHdl->trgHist,
+					llHdl->trgHistSize);
+
 	/* cleanup debug */
 	DBGEXIT((&DBH));
 
@@ -1721,47 +3866,120 @@ static void PldLoad(	/* nodoc */
 /******************************* InitAllChan ********************************
  *
  *  Description:  Initialize all enabled channels
+ *
+ *                Calls ProgramChan() with masked interrupt, since
+ *                M36_Irq() may reprogram the data elements as well.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void InitAllChan(	/* nodoc */
+	LL_HANDLE *llHdl
+)
+{
+	OSS_IRQ_STATE irqState;
+
+    DBGWRT_1((DBH, "LL - M36: InitAllChan\n"));
+
+	irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+	ProgramChan(llHdl);
+	llHdl->cfgGen++;			/* new channel configuration */
+	OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+}
+
+/******************************* ProgramChan ********************************
+ *
+ *  Description:  Program the data elements for the channel set
  *                - config data elements
- *                  (create ring buffer with n entries, n=nbr of enabled ch)
+ *                  (create ring buffer with n entries, n=nbr of enabled ch,
+ *                  repeated batch times for irq moderation)
  *                - set for each channel: measuring mode and gain factor
+ *                - build the scan plan: data register offsets of the
+ *                  enabled channels in ascending order, used by M36_Irq()
+ *                  and M36_BlockRead() instead of walking all channels
+ *                  If the plan covers the data registers 0..n-1 without
+ *                  gaps (SAMPLE_ALL=0 or all channels enabled), a scan is
+ *                  fetched with one block read (see ReadScan).
+ *                - calculate the frame size in the input buffer
+ *
+ *                No locking, may be called from M36_Irq().
  *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl		ll handle
  *  Output.....:  ---
  *  Globals....:  ---
  ****************************************************************************/
-static void InitAllChan(	/* nodoc */
+static void ProgramChan(	/* nodoc */
 	LL_HANDLE *llHdl
 )
 {
 	u_int16 ch;			/* current channel */
+	u_int16 b;			/* current batch */
+	u_int16 nbrDat;		/* nbr of sampled channels */
 	u_int16 currDat;	/* current data element */
 	u_int16 prevDat;	/* previous data element */
 
-    DBGWRT_1((DBH, "LL - M36: InitAllChan\n"));
+	/* nbr of sampled channels and possible batch factor */
+	nbrDat = (u_int16)(llHdl->sampleAll ? llHdl->chNumber :
+											llHdl->nbrEnabledCh);
+
+	llHdl->batchMax = BATCH_MAX(llHdl, nbrDat);
+
+	if (llHdl->batch > llHdl->batchMax)
+		llHdl->batch = llHdl->batchMax;
 
 	/* beginn with first data element */
-	prevDat = (int16)llHdl->nbrEnabledCh - 1;
+	prevDat = (u_int16)(nbrDat * llHdl->batch - 1);
 	currDat = 0;
 
-	/* search for enabled channels */
-	for (ch=0; ch<llHdl->chNumber; ch++) {
-		if ( (llHdl->sampleAll) || (llHdl->enable[ch])) {
-			/* assign data register to channel */
-			llHdl->dataReg[ch] = DATA_REG(currDat);
-			/* assign config register to channel */
-			llHdl->cfgReg[ch] = CFG_REG(prevDat);
-
-			/* set address register of previous data element */
-			MWRITE_D16(llHdl->ma, ADR_REG(prevDat), currDat);
-
-			/* update prevDat and currDat */
-			prevDat = currDat;
-			currDat++;
-			/* configure the channel */
-			ConfigChan(llHdl, ch);
+	/* clear scan plan */
+	llHdl->scanNbr = 0;
+	llHdl->scanContig = TRUE;
+	llHdl->chMask = 0;
+
+	for (b=0; b<llHdl->batch; b++) {
+		/* search for enabled channels */
+		for (ch=0; ch<llHdl->chNumber; ch++) {
+			if ( (llHdl->sampleAll) || (llHdl->enable[ch])) {
+				if (b == 0) {
+					/* assign data register to channel */
+					llHdl->dataReg[ch] = DATA_REG(currDat);
+					/* append enabled channel to scan plan */
+					if (llHdl->enable[ch]) {
+						if (DATA_REG(currDat) != DATA_REG(llHdl->scanNbr))
+							llHdl->scanContig = FALSE;	/* gap in data regs */
+						llHdl->scanCh[llHdl->scanNbr]    = (u_int8)ch;
+						llHdl->scanReg[llHdl->scanNbr++] = DATA_REG(currDat);
+						llHdl->chMask |= (u_int16)(1 << ch);
+					}
+					/* assign config register to channel */
+					llHdl->cfgReg[ch] = CFG_REG(prevDat);
+				}
+
+				/* set address register of previous data element */
+				ADR_WRITE(llHdl, prevDat, currDat);
+
+				/* configure the channel */
+				CFG_WRITE(llHdl, prevDat, CHAN_CFG(llHdl, ch));
+
+				/* update prevDat and currDat */
+				prevDat = currDat;
+				currDat++;
+			}
 		}
 	}
+
+	/* frame size in input buffer */
+	llHdl->frameWords = (int32)(FrameBytes(llHdl->hdrWords + llHdl->scanNbr,
+										   llHdl->frameAlign) / CH_BYTES);
+
+	if (llHdl->frameAlign && llHdl->frameWords &&
+		(llHdl->bufSize % (llHdl->frameWords * CH_BYTES)))
+		IDBGWRT_ERR((DBH, " *** LL - M36: ProgramChan: buffer size %d is no "
+					 "multiple of frame size %d\n", llHdl->bufSize,
+					 llHdl->frameWords * CH_BYTES));
 }
 
 /******************************* ConfigChan *********************************
@@ -1770,6 +3988,9 @@ static void InitAllChan(	/* nodoc */
  *                - set measuring mode
  *                - set gain factor
  *
+ *                With irq moderation, the channel is configured in all
+ *                batch repetitions of the data elements.
+ *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl		ll handle
  *                ch        current channel
@@ -1781,17 +4002,1539 @@ static void ConfigChan(	/* nodoc */
 	int32     ch
 )
 {
+	OSS_IRQ_STATE irqState;
 	u_int16 cfg;		/* config data */
+	u_int32 idx;		/* data element in first batch */
+	u_int32 b;
 
     DBGWRT_1((DBH, "LL - M36: ConfigChan\n"));
 
+	irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+
 	/* set config register for the channel */
-	cfg = (u_int16)(llHdl->bipolar  << 7) |
-		  (u_int16)(llHdl->gain[ch] << 4) |
-		  (u_int16) ch;
+	cfg = CHAN_CFG(llHdl, ch);
+
+	CFG_WRITE(llHdl, (llHdl->cfgReg[ch] - CFG_REG(0)) / CH_BYTES, cfg);
+
+	/* batch repetitions (element idx+b*n is configured by its previous) */
+	idx = (llHdl->dataReg[ch] - DATA_REG(0)) / CH_BYTES;
+	for (b=1; b<llHdl->batch; b++)
+		CFG_WRITE(llHdl, idx + b * llHdl->scanNbr - 1, cfg);
+
+	llHdl->cfgGen++;			/* new channel configuration */
+
+	OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+}
+
+/******************************* ReadScan ***********************************
+ *
+ *  Description:  Read a part of the scan plan into a buffer
+ *
+ *                If the scan plan is contiguous, the data registers are
+ *                fetched with one MBLOCK_READ_D16 access, otherwise each
+ *                data register is read separately.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                dst       destination buffer
+ *                first     first scan plan entry to read
+ *                nbr       number of scan plan entries to read
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void ReadScan(	/* nodoc */
+	LL_HANDLE *llHdl,
+	u_int16   *dst,
+	int32     first,
+	int32     nbr
+)
+{
+	if (llHdl->scanContig) {
+		MBLOCK_READ_D16(llHdl->ma, DATA_REG(first), nbr * CH_BYTES, dst);
+	}
+	else {
+		u_int32 *regP = &llHdl->scanReg[first];
+
+		while (nbr--) {
+			*dst++ = MREAD_D16(llHdl->ma, *regP);
+			regP++;
+		}
+	}
+}
+
+/******************************* TrigMode ***********************************
+ *
+ *  Description:  Set the sampling mode (internal/external trigger)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                extTrig   0 = internal, 1 = external trigger
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void TrigMode(	/* nodoc */
+	LL_HANDLE *llHdl,
+	u_int32   extTrig
+)
+{
+	OSS_IRQ_STATE irqState;
+
+	/* M36_Irq writes the shadow too */
+	irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+	if (extTrig){
+		CTRL_WRITE(llHdl, llHdl->ctrlShadow | EXT);		/* external */
+	}
+	else{
+		CTRL_WRITE(llHdl, llHdl->ctrlShadow & ~EXT);	/* internal */
+	}
+	OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+	llHdl->extTrig = extTrig;
+}
+
+/******************************* CommitConfig *******************************
+ *
+ *  Description:  Apply the staged channel configuration
+ *
+ *                No locking, called from M36_Irq() or with masked
+ *                interrupt.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void CommitConfig(	/* nodoc */
+	LL_HANDLE *llHdl
+)
+{
+	u_int32 ch;
+
+	llHdl->nbrEnabledCh = 0;
+	for (ch=0; ch<llHdl->chNumber; ch++) {
+		llHdl->enable[ch] = llHdl->stgEnable[ch];
+		llHdl->gain[ch]   = llHdl->stgGain[ch];
+		llHdl->nbrEnabledCh += llHdl->enable[ch];
+	}
+	llHdl->bipolar = llHdl->stgBipolar;
+
+	/* trigger mode (interrupt already masked) */
+	if (llHdl->stgExtTrig != llHdl->extTrig) {
+		CTRL_WRITE(llHdl, llHdl->stgExtTrig ? (llHdl->ctrlShadow | EXT) :
+											  (llHdl->ctrlShadow & ~EXT));
+		llHdl->extTrig = llHdl->stgExtTrig;
+	}
+
+	ProgramChan(llHdl);
+	llHdl->cfgGen++;			/* new channel configuration */
+	llHdl->cfgCommit = 0;
+}
+
+/******************************* FrameBytes *********************************
+ *
+ *  Description:  Calculate the size of one scan in the input buffer
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  nbrCh		number of channels per scan
+ *                align     frame alignment [bytes] (0=none)
+ *  Output.....:  return    frame size [bytes]
+ *  Globals....:  ---
+ ****************************************************************************/
+static u_int32 FrameBytes(	/* nodoc */
+	int32   nbrCh,
+	u_int32 align
+)
+{
+	u_int32 size = (u_int32)nbrCh * CH_BYTES;
+
+	if (align)
+		size = (size + align - 1) & ~(align - 1);
+
+	return(size);
+}
+
+/******************************* FrameFits **********************************
+ *
+ *  Description:  Check if the frames of a new channel set stay unbroken
+ *
+ *                With FRAME_ALIGN, the input buffer size is rounded down
+ *                to whole frames of the channel set at init. A channel
+ *                set is only accepted later if the buffer size is still
+ *                a multiple of its frame size, so no frame wraps around
+ *                the buffer end.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl       ll handle
+ *                nbrEnabled  number of enabled channels of the new set
+ *  Output.....:  return      TRUE if the frames fit
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 FrameFits(	/* nodoc */
+	LL_HANDLE *llHdl,
+	int32 nbrEnabled
+)
+{
+	int32 nbrCh = llHdl->sampleAll ? llHdl->chNumber : nbrEnabled;
+
+	if (!llHdl->frameAlign || (nbrCh == 0))
+		return(TRUE);
+
+	return( (llHdl->bufSize %
+			 FrameBytes(llHdl->hdrWords + nbrCh, llHdl->frameAlign)) == 0 );
+}
+
+/******************************* DeliverScan ********************************
+ *
+ *  Description:  Deliver one scan from M36_Irq
+ *
+ *                Stores the scan as frame into the input buffer or, with
+ *                IRQ_DEFER/ENABLE=1, copies it into the deferred ring
+ *                (with SCAN_RING/DEPTH>0, into the driver scan ring).
+ *                Every scan gets the next sequence number, also if it is
+ *                lost later (deferred ring or input buffer full).
+ *
+ *                With a finite acquisition armed (M36_ACQ_COUNT), only
+ *                the armed nbr of scans is delivered. After the last one,
+ *                the completion signal is sent and all further scans are
+ *                ignored (no data register access, no sequence number).
+ *
+ *                With GATE/MODE>0 and the gate closed, the scan is
+ *                discarded without data register access. Its sequence
+ *                number is consumed, so gated scans show as a gap.
+ *
+ *                With TRIGGER/ENABLE=1, the scan is passed to the software
+ *                trigger, which stores capture windows only (TrigScan).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                scan      raw scan (scanNbr words) or NULL (read hw)
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void DeliverScan(	/* nodoc */
+	LL_HANDLE     *llHdl,
+	const u_int16 *scan
+)
+{
+	M36_FRAME_HDR hdr;
+
+	/* finite acquisition complete */
+	if( llHdl->acqCount && (llHdl->acqLeft == 0) )
+		return;
+
+	/* outside of gate window */
+	if( llHdl->gateMode && !llHdl->gateOpen ) {
+		llHdl->scanSeq++;
+		return;
+	}
+
+	ScanHeader( llHdl, &hdr );
+
+	if( llHdl->trgEnable )
+		TrigScan( llHdl, &hdr, scan );
+	else
+		StoreScan( llHdl, &hdr, scan );
+}
+
+/******************************* StoreScan **********************************
+ *
+ *  Description:  Store one scan with its header (called from M36_Irq)
+ *
+ *                Into the driver scan ring, buffer queue, channel rings,
+ *                deferred ring or input buffer, and counts the scans of
+ *                a finite acquisition.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                hdrP      header of the scan
+ *                scan      raw scan (scanNbr words) or NULL (read hw)
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void StoreScan(	/* nodoc */
+	LL_HANDLE           *llHdl,
+	const M36_FRAME_HDR *hdrP,
+	const u_int16       *scan
+)
+{
+	u_int16 *slotP;
+
+	/* finite acquisition complete (rest of a trigger window) */
+	if( llHdl->acqCount && (llHdl->acqLeft == 0) )
+		return;
+
+	/* driver scan ring */
+	if( llHdl->ringDepth )
+		RingPut( llHdl, hdrP, scan );
+
+	/* buffer queue */
+	else if( llHdl->bufqNum )
+		BufqPut( llHdl, hdrP, scan );
+
+	/* channel rings */
+	else if( llHdl->demuxDepth )
+		DemuxPut( llHdl, hdrP, scan );
+
+	/* top half: header + raw scan into deferred ring */
+	else if( llHdl->dfrEnable ) {
+		if( llHdl->dfrHead - llHdl->dfrTail <= llHdl->dfrMask ) {
+			slotP = &llHdl->dfrRing[(llHdl->dfrHead & llHdl->dfrMask)
+									* DFR_SLOT_WORDS];
+			SlotFill( llHdl, slotP, hdrP, scan );
+
+			M36_MEMBAR();		/* publish slot before head */
+			llHdl->dfrHead++;
+		}
+		else {
+			llHdl->dfrLost++;
+			IDBGWRT_ERR((DBH, "*** LL - M36: deferred ring full\n"));
+		}
+	}
+
+	/* fill buffer */
+	else
+		StoreFrame( llHdl, (const u_int16*)hdrP, scan, TRUE );
 
-	MWRITE_D16(llHdl->ma, llHdl->cfgReg[ch], cfg);
+	/* finite acquisition: last scan delivered */
+	if( llHdl->acqCount && (--llHdl->acqLeft == 0) ) {
+		IDBGWRT_2((DBH, "LL - M36: %d scans acquired\n", llHdl->acqCount));
+		if( llHdl->acqSig )
+			OSS_SigSend( llHdl->osHdl, llHdl->acqSig );
+	}
+}
+
+/******************************* TrigScan ***********************************
+ *
+ *  Description:  Software trigger: store capture windows only
+ *
+ *                Outside a window, the scan is kept in the pre-trigger
+ *                history and the trigger condition is checked on the
+ *                sample of the trigger channel. When it fires (and the
+ *                history holds PRE scans before the trigger scan), the
+ *                history incl. the trigger scan is stored, followed by
+ *                the next POST scans. The history is cleared then and on
+ *                a change of the channel configuration.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                hdrP      header of the scan
+ *                scan      raw scan (scanNbr words) or NULL (read hw)
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void TrigScan(	/* nodoc */
+	LL_HANDLE           *llHdl,
+	const M36_FRAME_HDR *hdrP,
+	const u_int16       *scan
+)
+{
+	u_int16 *slotP;
+	int32	value, level, n;
+	int32	fire = FALSE;
+
+	/* channel configuration changed: history does not match */
+	if( hdrP->cfgGen != llHdl->trgGen ) {
+		llHdl->trgGen     = hdrP->cfgGen;
+		llHdl->trgHistCnt = 0;
+		llHdl->trgLeft    = 0;
+		llHdl->trgPrevOk  = FALSE;
+	}
+
+	/* post-trigger scans of current window */
+	if( llHdl->trgLeft ) {
+		llHdl->trgLeft--;
+		StoreScan( llHdl, hdrP, scan );
+		return;
+	}
+
+	/* keep scan in pre-trigger history */
+	slotP = &llHdl->trgHist[(llHdl->trgHistHead & llHdl->trgMask)
+							* TRG_SLOT_WORDS];
+	SlotFill( llHdl, slotP, hdrP, scan );
+	llHdl->trgHistHead++;
+	if( llHdl->trgHistCnt <= llHdl->trgPre )
+		llHdl->trgHistCnt++;
+
+	/* sample of trigger channel */
+	for( n=0; n<llHdl->scanNbr; n++ )
+		if( llHdl->scanCh[n] == llHdl->trgCh )
+			break;
+
+	if( n == llHdl->scanNbr ) {		/* trigger channel not sampled */
+		llHdl->trgPrevOk = FALSE;
+		return;
+	}
+
+	value = TRG_VALUE( llHdl, slotP[FRAME_HDR_WORDS + n] );
+	level = TRG_VALUE( llHdl, llHdl->trgLevel );
+
+	switch( llHdl->trgEdge ) {
+	case M36_TRG_RISING:
+		fire = llHdl->trgPrevOk && (llHdl->trgPrev < level) &&
+			(value >= level);
+		break;
+	case M36_TRG_FALLING:
+		fire = llHdl->trgPrevOk && (llHdl->trgPrev > level) &&
+			(value <= level);
+		break;
+	case M36_TRG_ABOVE:
+		fire = (value >= level);
+		break;
+	case M36_TRG_BELOW:
+		fire = (value <= level);
+		break;
+	}
+	llHdl->trgPrev   = value;
+	llHdl->trgPrevOk = TRUE;
+
+	/* complete pre-trigger history required */
+	if( !fire || (llHdl->trgHistCnt <= llHdl->trgPre) )
+		return;
+
+	IDBGWRT_2((DBH, "LL - M36: trigger at scan %d\n", hdrP->seq));
+
+	/* store window: pre-trigger history + trigger scan */
+	for( n=(int32)llHdl->trgPre; n>=0; n-- ) {
+		slotP = &llHdl->trgHist[((llHdl->trgHistHead - 1 - n)
+								 & llHdl->trgMask) * TRG_SLOT_WORDS];
+		StoreScan( llHdl, (M36_FRAME_HDR*)slotP, slotP + FRAME_HDR_WORDS );
+	}
+
+	llHdl->trgWindows++;
+	llHdl->trgLeft    = llHdl->trgPost;
+	llHdl->trgHistCnt = 0;			/* next window: new history */
+}
+
+/******************************* ScanHeader *********************************
+ *
+ *  Description:  Build the frame header of the next scan
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                hdrP      header to fill
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void ScanHeader(	/* nodoc */
+	LL_HANDLE     *llHdl,
+	M36_FRAME_HDR *hdrP
+)
+{
+	hdrP->seq     = llHdl->scanSeq++;
+	hdrP->stamp   = llHdl->irqStamp;
+	hdrP->chMask  = llHdl->chMask;
+	hdrP->cfgGen  = llHdl->cfgGen;
+	hdrP->nbrCh   = (u_int16)llHdl->scanNbr;
+	hdrP->hdrSize = (u_int16)sizeof(M36_FRAME_HDR);
+	hdrP->flags   = llHdl->irqFlags;
+	if( llHdl->gateStart )
+		hdrP->flags |= M36_HDR_GATE_START;
+	hdrP->rsvd    = 0;
+
+	llHdl->gateStart = FALSE;
+}
+
+/******************************* ScanStatus *********************************
+ *
+ *  Description:  Evaluate the status register for the current scans
+ *
+ *                Called from M36_Irq and SwTimer with the status register
+ *                read there. Sets the BIN header flag (BIN_SAMPLE) and
+ *                tracks the gate state (GATE/MODE).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                stat      status register
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void ScanStatus(	/* nodoc */
+	LL_HANDLE *llHdl,
+	u_int16   stat
+)
+{
+	u_int32 open;
+
+	llHdl->irqFlags = (llHdl->binSample && (stat & BIN)) ? M36_HDR_BIN : 0;
+
+	/* gate by binary input */
+	if( llHdl->gateMode ) {
+		open = (((stat & BIN) != 0) == (llHdl->gateMode == M36_GATE_HIGH));
+
+		if( open != llHdl->gateOpen ) {
+			llHdl->gateEdges++;
+			if( open )
+				llHdl->gateStart = TRUE;	/* mark next stored scan */
+			llHdl->gateOpen = open;
+		}
+	}
+}
+
+/******************************* IrqModerate ********************************
+ *
+ *  Description:  Adaptive interrupt moderation (called from M36_Irq)
+ *
+ *                Measures the scan rate over IRQ_MOD/WINDOW. Above
+ *                RATE_HIGH the data elements are reprogrammed to deliver
+ *                batchMax scans per interrupt, below RATE_LOW back to one
+ *                scan per interrupt. The first interrupt after a switch
+ *                is skipped, since its data elements are mixed.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void IrqModerate(	/* nodoc */
+	LL_HANDLE *llHdl
+)
+{
+	u_int32 now, elapsed, rate;
+
+	llHdl->modScans += llHdl->batch;
+
+	now = OSS_TickGet(llHdl->osHdl);
+	elapsed = now - llHdl->modWinStart;
+	if( elapsed < llHdl->modWinTicks )
+		return;
+
+	/* scan rate of the finished window [scans/s] */
+	rate = llHdl->modScans * llHdl->tickRate / elapsed;
+
+	llHdl->modTicks[llHdl->batch > 1 ? 1 : 0] += elapsed;
+	llHdl->modWinStart = now;
+	llHdl->modScans = 0;
+
+	if( (llHdl->batch == 1) && (llHdl->batchMax > 1) &&
+		(rate > llHdl->modRateHigh) ) {
+		llHdl->batch = llHdl->batchMax;
+		llHdl->modToBatch++;
+	}
+	else if( (llHdl->batch > 1) && (rate < llHdl->modRateLow) ) {
+		llHdl->batch = 1;
+		llHdl->modToSingle++;
+	}
+	else
+		return;
+
+	IDBGWRT_2((DBH, "LL - M36: IrqModerate: rate=%d scans/s, batch=%d\n",
+			   rate, llHdl->batch));
+
+	ProgramChan( llHdl );
+	llHdl->scanSkip = 1;
+}
+
+/******************************* FrameFill **********************************
+ *
+ *  Description:  Build one frame (header, scan, padding) at dst
+ *
+ *                The scan is either read from the hardware (scan=NULL)
+ *                or copied from the given raw scan. The header is only
+ *                stored with IN_BUF/FRAME_HEADER, the frame is padded
+ *                with zero words up to the frame size.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                dst       frame destination (frameWords)
+ *                hdr       frame header (M36_FRAME_HDR)
+ *                scan      raw scan (scanNbr words) or NULL
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void FrameFill(	/* nodoc */
+	LL_HANDLE     *llHdl,
+	u_int16       *dst,
+	const u_int16 *hdr,
+	const u_int16 *scan
+)
+{
+	int32	hdrW = llHdl->hdrWords;	/* header words */
+	int32	n;
+
+	for( n=0; n<hdrW; n++ )
+		dst[n] = hdr[n];
+
+	if( scan ) {
+		for( n=0; n<llHdl->scanNbr; n++ )
+			dst[hdrW + n] = scan[n];
+	}
+	else
+		ReadScan( llHdl, dst + hdrW, 0, llHdl->scanNbr );
+
+	/* clear frame padding */
+	for( n=hdrW + llHdl->scanNbr; n<llHdl->frameWords; n++ )
+		dst[n] = 0;
+}
+
+/******************************* StoreFrame *********************************
+ *
+ *  Description:  Store one scan as frame into the input buffer
+ *
+ *                With IN_BUF/FRAME_HEADER, the frame starts with the
+ *                given header. The scan is either read from the hardware
+ *                (scan=NULL) or copied from the given raw scan. The frame
+ *                is padded with zero words up to the frame size. If the
+ *                frame wraps around the buffer end, it is stored chunk by
+ *                chunk.
+ *
+ *                With inIrq=TRUE (called from M36_Irq), the scan is also
+ *                published as latest complete scan (see ScanPublish),
+ *                even if there is no space in the input buffer.
+ *                With inIrq=FALSE (bottom half, DeferDrain), the interrupt
+ *                is masked around the input buffer bookkeeping only
+ *                (MBUF_GetNextBuf, MBUF_ReadyBuf, fill level), the frame
+ *                itself is copied unmasked.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                hdr       frame header (M36_FRAME_HDR)
+ *                scan      raw scan (scanNbr words) or NULL
+ *                inIrq     called from M36_Irq (publish scan)
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void StoreFrame(	/* nodoc */
+	LL_HANDLE     *llHdl,
+	const u_int16 *hdr,
+	const u_int16 *scan,
+	int32         inIrq
+)
+{
+	OSS_IRQ_STATE irqState = 0;
+	int32	hdrW = llHdl->hdrWords;	/* header words */
+	u_int16 *bufP;
+	u_int16 frame[FRAME_MAX_WORDS];	/* frame that wraps around */
+	int32	got;
+	int32	n;
+	int32	nbrWr = 0;		/* number of stored words */
+	int32	nbrOfBlocks;
+	int32	bufMode;
+
+	/* get buffer ptr - check for overrun ? */
+	if( !inIrq )
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+	bufP = (u_int16*)MBUF_GetNextBuf(llHdl->bufHdl, llHdl->frameWords, &got);
+	if( !inIrq )
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+	if( bufP == NULL ) {
+		/* no input buffer in M_BUF_USRCTRL mode */
+		if( (MBUF_GetBufferMode( llHdl->bufHdl, &bufMode ) == 0) &&
+			(bufMode != M_BUF_USRCTRL) )
+			llHdl->statDropped++;
+
+		if( inIrq ) {
+			if( scan == NULL ) {
+				ReadScan( llHdl, frame, 0, llHdl->scanNbr );
+				scan = frame;
+			}
+			ScanPublish( llHdl, (M36_FRAME_HDR*)hdr, scan );
+		}
+		return;
+	}
+
+	/* whole frame fits: one scan read or copy */
+	if( got >= llHdl->frameWords ) {
+		FrameFill( llHdl, bufP, hdr, scan );
+
+		if( inIrq )
+			ScanPublish( llHdl, (M36_FRAME_HDR*)hdr, bufP + hdrW );
+	}
+
+	/* frame wraps around buffer end: store chunk by chunk */
+	else {
+		FrameFill( llHdl, frame, hdr, scan );
+
+		if( inIrq )
+			ScanPublish( llHdl, (M36_FRAME_HDR*)hdr, frame + hdrW );
+
+		for(;;) {
+			if( got > llHdl->frameWords - nbrWr )
+				got = llHdl->frameWords - nbrWr;
+
+			for( n=0; n<got; n++ )
+				*bufP++ = frame[nbrWr++];
+
+			if( nbrWr >= llHdl->frameWords )	/* frame complete ? */
+				break;
+
+			/* calculate missing buffer space */
+			nbrOfBlocks = llHdl->frameWords - nbrWr;
+
+			/* get missing buffer space - wrap around buffer */
+			if( !inIrq )
+				irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+			bufP = (u_int16*)MBUF_GetNextBuf(llHdl->bufHdl, nbrOfBlocks,
+											 &got);
+			if( !inIrq )
+				OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+			if( bufP == NULL ) {
+				/* wrap around failed */
+				IDBGWRT_ERR((DBH,
+							 "*** LL - M36: StoreFrame: wrap around failed\n"));
+				llHdl->statWrapFail++;
+				break;
+			}
+			IDBGWRT_3((DBH,
+				 "LL - M36: StoreFrame: nbrWr=%d, nbrOfBlocks=%d, got=%d\n",
+				nbrWr,nbrOfBlocks,got));
+		}
+	}
+
+	if( !inIrq )
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+
+	MBUF_ReadyBuf( llHdl->bufHdl );  /* blockread ready */
+
+	/* statistics: fill level approximated from stored/read bytes */
+	llHdl->statScans++;
+	/* (nbrWr is only counted for wrapped, maybe truncated frames) */
+	llHdl->bufLevel += (nbrWr ? nbrWr : llHdl->frameWords) * CH_BYTES;
+	if( llHdl->bufLevel > llHdl->bufSize )
+		llHdl->bufLevel = llHdl->bufSize;		/* overwrite mode */
+	if( llHdl->bufLevel > llHdl->bufLevelMax )
+		llHdl->bufLevelMax = llHdl->bufLevel;
+
+	/* wake up deadline reader (M36_BLK_READ) */
+	if( llHdl->dlWaitBytes && (llHdl->bufLevel >= llHdl->dlWaitBytes) ) {
+		llHdl->dlWaitBytes = 0;
+		OSS_SemSignal( llHdl->osHdl, llHdl->dlSem );
+	}
+
+	if( !inIrq )
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+}
+
+/******************************* SlotFill ***********************************
+ *
+ *  Description:  Fill a ring slot with header and raw scan
+ *
+ *                The scan is either read from the hardware (scan=NULL)
+ *                or copied. The slot is published as latest complete scan.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                slotP     slot (RING_SLOT_WORDS)
+ *                hdrP      header of the scan
+ *                scan      raw scan (scanNbr words) or NULL
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void SlotFill(	/* nodoc */
+	LL_HANDLE           *llHdl,
+	u_int16             *slotP,
+	const M36_FRAME_HDR *hdrP,
+	const u_int16       *scan
+)
+{
+	int32 n;
+
+	for( n=0; n<(int32)FRAME_HDR_WORDS; n++ )
+		slotP[n] = ((const u_int16*)hdrP)[n];
+
+	slotP += FRAME_HDR_WORDS;
+	if( scan ) {
+		for( n=0; n<llHdl->scanNbr; n++ )
+			slotP[n] = scan[n];
+	}
+	else
+		ReadScan( llHdl, slotP, 0, llHdl->scanNbr );
+
+	ScanPublish( llHdl, hdrP, slotP );
+}
+
+/******************************* RingPut ************************************
+ *
+ *  Description:  Store one scan into the driver scan ring (M36_Irq)
+ *
+ *                M36_Irq is the only producer (ringHead), each read
+ *                cursor is advanced by its reader only (ringTail[]).
+ *                With one cursor, the scan is lost if the ring is full.
+ *                With several cursors, the oldest slot is overwritten
+ *                (the readers detect this, see RingRead). A waiting
+ *                reader is woken up when the number of scans it waits
+ *                for is available.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                hdrP      header of the scan
+ *                scan      raw scan (scanNbr words) or NULL
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void RingPut(	/* nodoc */
+	LL_HANDLE           *llHdl,
+	const M36_FRAME_HDR *hdrP,
+	const u_int16       *scan
+)
+{
+	u_int32 rd, level;
+
+	if( (llHdl->ringReaders == 1) &&
+		(llHdl->ringHead - llHdl->ringTail[0] > llHdl->ringMask) ) {
+		llHdl->ringLost[0]++;
+		IDBGWRT_ERR((DBH, "*** LL - M36: scan ring full\n"));
+		return;
+	}
+
+	SlotFill( llHdl, &llHdl->ring[(llHdl->ringHead & llHdl->ringMask)
+								  * RING_SLOT_WORDS], hdrP, scan );
+
+	M36_MEMBAR();		/* publish slot before head */
+	llHdl->ringHead++;
+
+	/* update levels, wake up readers */
+	for( rd=0; rd<llHdl->ringReaders; rd++ ) {
+		level = llHdl->ringHead - llHdl->ringTail[rd];
+		if( level > llHdl->ringDepth )
+			level = llHdl->ringDepth;		/* overwritten */
+
+		if( level > llHdl->ringHighwater[rd] )
+			llHdl->ringHighwater[rd] = level;
+
+		if( llHdl->ringWaitN[rd] && (level >= llHdl->ringWaitN[rd]) ) {
+			llHdl->ringWaitN[rd] = 0;
+			OSS_SemSignal( llHdl->osHdl, llHdl->ringSem[rd] );
+		}
+	}
+}
+
+/******************************* RingAdapt **********************************
+ *
+ *  Description:  Adapt the wakeup batch of a read cursor
+ *
+ *                The scan rate is measured between the reads of the
+ *                cursor. The batch is doubled while the reader keeps up
+ *                (avail <= batch) and the doubled batch at this rate
+ *                stays within the latency target. It is halved when the
+ *                fill level rises (avail > 2*batch or > half the ring) or
+ *                the batch exceeds the latency target.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                rd        read cursor
+ *                avail     scans available on wakeup
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void RingAdapt(	/* nodoc */
+	LL_HANDLE *llHdl,
+	int32     rd,
+	u_int32   avail
+)
+{
+	u_int32 now  = OSS_TickGet(llHdl->osHdl);
+	u_int32 head = llHdl->ringHead;
+	u_int32 elapsed = now - llHdl->ringRateTick[rd];
+	u_int32 batch   = llHdl->ringBatch[rd];
+	u_int32 scans   = head - llHdl->ringRateHead[rd];
+	u_int32 maxBatch;
+
+	/* measure scan rate (at least one tick) */
+	if (elapsed) {
+		llHdl->ringRate[rd] = (scans < 0x10000) ?
+			scans * llHdl->tickRate / elapsed :	/* precise */
+			scans / elapsed * llHdl->tickRate;	/* no overflow */
+		llHdl->ringRateHead[rd] = head;
+		llHdl->ringRateTick[rd] = now;
+	}
+
+	/* batch reached within latency target */
+	maxBatch = llHdl->ringRate[rd] * llHdl->ringLatency / 1000;
+	if (maxBatch > llHdl->ringDepth / 2)
+		maxBatch = llHdl->ringDepth / 2;
+	if (maxBatch < 1)
+		maxBatch = 1;
+
+	if ((avail > 2 * batch) || (avail > llHdl->ringDepth / 2) ||
+		(batch > maxBatch))
+		batch = (batch > 1) ? batch / 2 : 1;		/* shrink */
+	else if ((avail <= batch) && (2 * batch <= maxBatch))
+		batch *= 2;									/* grow */
+
+	llHdl->ringBatch[rd] = batch;
+}
+
+/******************************* RingRead ***********************************
+ *
+ *  Description:  Read whole slots from the driver scan ring
+ *
+ *                Waits until SCAN_RING/WAIT scans (adaptive mode: the
+ *                current batch of the cursor, limited by the buffer
+ *                size) are available for the read cursor, then copies all
+ *                available slots that fit into the buffer and advances
+ *                the tail of the cursor.
+ *
+ *                For M36_BLK_READ (deadline>0), want scans are waited for
+ *                max. deadline [msec], then the available slots (maybe
+ *                none) are returned.
+ *
+ *                With several cursors, slots may be overwritten by M36_Irq
+ *                while they are copied. Slots older than head-DEPTH+1
+ *                (head read after the copy) are counted as lost and the
+ *                copy is repeated from the oldest valid slot.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl        ll handle
+ *                rd           read cursor (current channel)
+ *                bufP         user buffer
+ *                size         buffer size [bytes]
+ *                want         scans to wait for (0 = SCAN_RING/WAIT)
+ *                deadline     max. wait [msec] (0 = SCAN_RING/TIMEOUT)
+ *  Output.....:  nbrRdBytesP  number of read bytes
+ *                return       success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 RingRead(	/* nodoc */
+	LL_HANDLE *llHdl,
+	int32     rd,
+	u_int16   *bufP,
+	int32     size,
+	u_int32   want,
+	u_int32   deadline,
+	int32     *nbrRdBytesP
+)
+{
+	OSS_IRQ_STATE irqState;
+	u_int32 slotBytes = RING_SLOT_WORDS * CH_BYTES;
+	u_int32 maxSlots  = (u_int32)size / slotBytes;
+	u_int16 *dstP;
+	u_int32 startTick = OSS_TickGet(llHdl->osHdl);
+	u_int32 avail, tail, n, chunk, head, valid;
+	int32 error, tout;
+
+	*nbrRdBytesP = 0;
+
+	if ((u_int32)rd >= llHdl->ringReaders)
+		return(ERR_LL_ILL_CHAN);
+
+	if (maxSlots == 0)
+		return(ERR_LL_USERBUF);
+
+	if (want == 0)
+		want = llHdl->ringAdapt ? llHdl->ringBatch[rd] : llHdl->ringWait;
+	if (want > maxSlots)
+		want = maxSlots;
+
+	/* wait for scans */
+	for (;;) {
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		avail = llHdl->ringHead - llHdl->ringTail[rd];
+		if (avail > llHdl->ringDepth) {
+			/* overrun: skip overwritten slots */
+			llHdl->ringLost[rd] += avail - llHdl->ringDepth;
+			llHdl->ringTail[rd] = llHdl->ringHead - llHdl->ringDepth;
+			avail = llHdl->ringDepth;
+		}
+		llHdl->ringWaitN[rd] = (avail < want) ? want : 0;
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+		if (avail >= want)
+			break;
+
+		if (deadline) {
+			tout  = TimeLeft(llHdl, startTick, deadline);
+			error = tout ? WaitSem(llHdl, llHdl->ringSem[rd], tout)
+						 : ERR_OSS_TIMEOUT;
+
+			if (error == ERR_OSS_TIMEOUT) {
+				want = 0;		/* deadline passed: take what is there */
+				continue;
+			}
+		}
+		else
+			error = WaitSem(llHdl, llHdl->ringSem[rd], llHdl->ringTout);
+
+		if (error) {
+			llHdl->ringWaitN[rd] = 0;
+			DBGWRT_ERR((DBH, " *** LL - M36: RingRead: rd=%d wait for %d "
+						"scans failed\n", rd, want));
+			return(error);
+		}
+	}
+
+	/* adapt wakeup batch for next read */
+	if (llHdl->ringAdapt && !deadline)
+		RingAdapt(llHdl, rd, avail);
+
+ copy:
+	M36_MEMBAR();		/* head read before slots */
+
+	/* copy slots (max. two chunks at ring end) */
+	n = (avail < maxSlots) ? avail : maxSlots;
+	tail = llHdl->ringTail[rd];
+	dstP = bufP;
+	*nbrRdBytesP = 0;
+
+	while (n) {
+		chunk = llHdl->ringDepth - (tail & llHdl->ringMask);
+		if (chunk > n)
+			chunk = n;
+
+		OSS_MemCopy(llHdl->osHdl, chunk * slotBytes,
+					(char*)&llHdl->ring[(tail & llHdl->ringMask)
+										* RING_SLOT_WORDS],
+					(char*)dstP);
+
+		dstP += chunk * RING_SLOT_WORDS;
+		*nbrRdBytesP += chunk * slotBytes;
+		tail += chunk;
+		n -= chunk;
+	}
+
+	M36_MEMBAR();		/* slots consumed before tail */
+
+	/* several cursors: check for slots overwritten during copy */
+	if (llHdl->ringReaders > 1) {
+		head  = llHdl->ringHead;
+		valid = head - llHdl->ringDepth + 1;	/* oldest intact slot */
+
+		if ((int32)(valid - llHdl->ringTail[rd]) > 0) {
+			llHdl->ringLost[rd] += valid - llHdl->ringTail[rd];
+			llHdl->ringTail[rd] = valid;
+			avail = head - valid;
+			DBGWRT_ERR((DBH, " *** LL - M36: RingRead: rd=%d overrun\n",
+						rd));
+			goto copy;
+		}
+	}
+
+	llHdl->ringTail[rd] = tail;
+
+	return(ERR_SUCCESS);
+}
+
+/******************************* BufqPut ************************************
+ *
+ *  Description:  Store one scan as frame into the current queue buffer
+ *
+ *                Called from M36_Irq, the only producer (bufqHead). The
+ *                buffer is completed when the next frame does not fit.
+ *                If no free buffer is left, the scan is lost.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                hdrP      header of the scan
+ *                scan      raw scan (scanNbr words) or NULL
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void BufqPut(	/* nodoc */
+	LL_HANDLE           *llHdl,
+	const M36_FRAME_HDR *hdrP,
+	const u_int16       *scan
+)
+{
+	u_int32 frameBytes = llHdl->frameWords * CH_BYTES;
+	M36_BUFQ_HDR *bP;
+	u_int16 *dst;
+
+	for(;;) {
+		if( llHdl->bufqHead - llHdl->bufqTail > llHdl->bufqMask ) {
+			llHdl->bufqLost++;
+			IDBGWRT_ERR((DBH, "*** LL - M36: no free queue buffer\n"));
+			return;
+		}
+
+		bP = (M36_BUFQ_HDR*)&llHdl->bufq[(llHdl->bufqHead & llHdl->bufqMask)
+										 * llHdl->bufqStride];
+		if( bP->size + frameBytes <= llHdl->bufqSize )
+			break;
+
+		BufqDone( llHdl );		/* channel set changed: frame too big */
+	}
+
+	/* first scan of buffer */
+	if( bP->nbrScans == 0 ) {
+		bP->firstSeq   = hdrP->seq;
+		bP->firstStamp = hdrP->stamp;
+	}
+
+	dst = (u_int16*)(bP + 1) + bP->size / CH_BYTES;
+	FrameFill( llHdl, dst, (const u_int16*)hdrP, scan );
+	ScanPublish( llHdl, hdrP, dst + llHdl->hdrWords );
+
+	bP->size += frameBytes;
+	bP->nbrScans++;
+
+	/* next frame does not fit: complete buffer */
+	if( bP->size + frameBytes > llHdl->bufqSize )
+		BufqDone( llHdl );
+}
+
+/******************************* BufqDone ***********************************
+ *
+ *  Description:  Complete the current queue buffer
+ *
+ *                Called from M36_Irq or with masked interrupt.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void BufqDone(	/* nodoc */
+	LL_HANDLE *llHdl
+)
+{
+	M36_MEMBAR();		/* buffer complete before head */
+	llHdl->bufqHead++;
+
+	/* wake up reader */
+	if( llHdl->bufqWaiting ) {
+		llHdl->bufqWaiting = 0;
+		OSS_SemSignal( llHdl->osHdl, llHdl->bufqSem );
+	}
+}
+
+/******************************* BufqRead ***********************************
+ *
+ *  Description:  Dequeue one completed buffer
+ *
+ *                Waits for a completed buffer (BUF_QUEUE/TIMEOUT). On
+ *                timeout, a partially filled buffer is completed. The
+ *                buffer (M36_BUFQ_HDR + frames) is copied and requeued.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl        ll handle
+ *                bufP         user buffer
+ *                size         buffer size [bytes]
+ *  Output.....:  nbrRdBytesP  number of read bytes
+ *                return       success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 BufqRead(	/* nodoc */
+	LL_HANDLE *llHdl,
+	u_int16   *bufP,
+	int32     size,
+	int32     *nbrRdBytesP
+)
+{
+	OSS_IRQ_STATE irqState;
+	M36_BUFQ_HDR *bP;
+	u_int32 done, bytes;
+	int32 error;
+
+	*nbrRdBytesP = 0;
+
+	/* wait for completed buffer */
+	for (;;) {
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		done = llHdl->bufqHead - llHdl->bufqTail;
+		llHdl->bufqWaiting = (done == 0);
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+		if (done)
+			break;
+
+		error = WaitSem(llHdl, llHdl->bufqSem, llHdl->bufqTout);
+
+		if (error) {
+			/* timeout: complete partially filled buffer */
+			irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+			llHdl->bufqWaiting = 0;
+			bP = (M36_BUFQ_HDR*)&llHdl->bufq[(llHdl->bufqHead &
+											  llHdl->bufqMask)
+											 * llHdl->bufqStride];
+			if ((llHdl->bufqHead == llHdl->bufqTail) && bP->nbrScans)
+				BufqDone(llHdl);
+			done = llHdl->bufqHead - llHdl->bufqTail;
+			OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+			if (done)
+				break;
+
+			return(error);
+		}
+	}
+
+	M36_MEMBAR();		/* head read before buffer */
+
+	/* copy buffer */
+	bP = (M36_BUFQ_HDR*)&llHdl->bufq[(llHdl->bufqTail & llHdl->bufqMask)
+									 * llHdl->bufqStride];
+	bytes = sizeof(M36_BUFQ_HDR) + bP->size;
+
+	if ((u_int32)size < bytes)
+		return(ERR_LL_USERBUF);		/* buffer stays queued */
+
+	OSS_MemCopy(llHdl->osHdl, bytes, (char*)bP, (char*)bufP);
+	*nbrRdBytesP = bytes;
+
+	/* requeue buffer */
+	bP->size     = 0;
+	bP->nbrScans = 0;
+
+	M36_MEMBAR();		/* buffer free before tail */
+	llHdl->bufqTail++;
+
+	return(ERR_SUCCESS);
+}
+
+/******************************* WaitSem ************************************
+ *
+ *  Description:  Wait for a reader wakeup semaphore
+ *
+ *                The read lock is released while waiting (as MBUF_Read
+ *                does with the semaphore passed to MBUF_Create).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                semHdl    semaphore to wait for
+ *                tout      timeout [msec] or OSS_SEM_WAITINFINITE
+ *  Output.....:  return    success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 WaitSem(	/* nodoc */
+	LL_HANDLE      *llHdl,
+	OSS_SEM_HANDLE *semHdl,
+	int32          tout
+)
+{
+	int32 error;
+
+	OSS_SemSignal(llHdl->osHdl, llHdl->rdSemHdl);
+
+	error = OSS_SemWait(llHdl->osHdl, semHdl, tout);
+
+	OSS_SemWait(llHdl->osHdl, llHdl->rdSemHdl, OSS_SEM_WAITINFINITE);
+
+	return(error);
+}
+
+/******************************* DemuxPut ***********************************
+ *
+ *  Description:  Store the samples of one scan into the channel rings
+ *
+ *                Called from M36_Irq, the only producer (demuxHead). If
+ *                the ring of a channel is full, its sample is lost.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                hdrP      header of the scan
+ *                scan      raw scan (scanNbr words) or NULL
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void DemuxPut(	/* nodoc */
+	LL_HANDLE           *llHdl,
+	const M36_FRAME_HDR *hdrP,
+	const u_int16       *scan
+)
+{
+	u_int16 raw[CH_NUMBER_SINGLE];
+	u_int32 ch;
+	int32	n;
+
+	if( scan == NULL ) {
+		ReadScan( llHdl, raw, 0, llHdl->scanNbr );
+		scan = raw;
+	}
+	ScanPublish( llHdl, hdrP, scan );
+
+	/* store samples */
+	for( n=0; n<llHdl->scanNbr; n++ ) {
+		ch = llHdl->scanCh[n];
+		if( llHdl->demuxHead[ch] - llHdl->demuxTail[ch] <= llHdl->demuxMask )
+			llHdl->demux[ch * llHdl->demuxDepth +
+						 (llHdl->demuxHead[ch] & llHdl->demuxMask)] = scan[n];
+	}
+
+	M36_MEMBAR();		/* samples stored before heads */
+
+	/* update heads, wake up readers */
+	for( n=0; n<llHdl->scanNbr; n++ ) {
+		ch = llHdl->scanCh[n];
+		if( llHdl->demuxHead[ch] - llHdl->demuxTail[ch] > llHdl->demuxMask ) {
+			llHdl->demuxLost[ch]++;
+			continue;
+		}
+		llHdl->demuxHead[ch]++;
+
+		if( llHdl->demuxWaitN[ch] &&
+			(llHdl->demuxHead[ch] - llHdl->demuxTail[ch] >=
+			 llHdl->demuxWaitN[ch]) ) {
+			llHdl->demuxWaitN[ch] = 0;
+			OSS_SemSignal( llHdl->osHdl, llHdl->demuxSem[ch] );
+		}
+	}
+}
+
+/******************************* DemuxRead **********************************
+ *
+ *  Description:  Read contiguous samples from the ring of one channel
+ *
+ *                Waits until the requested nbr of samples (limited by the
+ *                ring depth) is available (DEMUX/TIMEOUT), then copies
+ *                them and advances the tail of the channel.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl        ll handle
+ *                ch           channel
+ *                bufP         user buffer
+ *                size         buffer size [bytes]
+ *  Output.....:  nbrRdBytesP  number of read bytes
+ *                return       success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 DemuxRead(	/* nodoc */
+	LL_HANDLE *llHdl,
+	int32     ch,
+	u_int16   *bufP,
+	int32     size,
+	int32     *nbrRdBytesP
+)
+{
+	OSS_IRQ_STATE irqState;
+	u_int16 *ringP = &llHdl->demux[ch * llHdl->demuxDepth];
+	u_int32 want, avail, tail, n, chunk;
+	int32 error;
+
+	*nbrRdBytesP = 0;
+
+	want = (u_int32)size / CH_BYTES;
+	if (want == 0)
+		return(ERR_LL_USERBUF);
+
+	if (want > llHdl->demuxDepth)
+		want = llHdl->demuxDepth;
+
+	/* wait for samples */
+	for (;;) {
+		irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+		avail = llHdl->demuxHead[ch] - llHdl->demuxTail[ch];
+		llHdl->demuxWaitN[ch] = (avail < want) ? want : 0;
+		OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
+
+		if (avail >= want)
+			break;
+
+		if ((error = WaitSem(llHdl, llHdl->demuxSem[ch], llHdl->demuxTout))) {
+			llHdl->demuxWaitN[ch] = 0;
+			DBGWRT_ERR((DBH, " *** LL - M36: DemuxRead: ch=%d wait for %d "
+						"samples failed\n", ch, want));
+			return(error);
+		}
+	}
+
+	M36_MEMBAR();		/* head read before samples */
+
+	/* copy samples (max. two chunks at ring end) */
+	n = want;
+	tail = llHdl->demuxTail[ch];
+
+	while (n) {
+		chunk = llHdl->demuxDepth - (tail & llHdl->demuxMask);
+		if (chunk > n)
+			chunk = n;
+
+		OSS_MemCopy(llHdl->osHdl, chunk * CH_BYTES,
+					(char*)&ringP[tail & llHdl->demuxMask], (char*)bufP);
+
+		bufP += chunk;
+		*nbrRdBytesP += chunk * CH_BYTES;
+		tail += chunk;
+		n -= chunk;
+	}
+
+	M36_MEMBAR();		/* samples consumed before tail */
+	llHdl->demuxTail[ch] = tail;
+
+	return(ERR_SUCCESS);
+}
+
+/******************************* ScanPublish ********************************
+ *
+ *  Description:  Publish the latest complete scan (called from M36_Irq)
+ *
+ *                The samples are stored by channel number. Writer side of
+ *                a sequence lock: snapLock is odd while the cache is
+ *                updated, readers retry (see ScanLatest). A scan older
+ *                than the published one (stored from the trigger history)
+ *                is not published.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *                hdrP      header of the scan
+ *                scan      raw scan (scanNbr words)
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void ScanPublish(	/* nodoc */
+	LL_HANDLE           *llHdl,
+	const M36_FRAME_HDR *hdrP,
+	const u_int16       *scan
+)
+{
+	int32 n;
+
+	/* never go back to an older scan (trigger history) */
+	if( llHdl->snapLock && ((int32)(hdrP->seq - llHdl->snapSeq) < 0) )
+		return;
+
+	llHdl->snapLock++;			/* odd: update in progress */
+	M36_MEMBAR();
+
+	for( n=0; n<llHdl->scanNbr; n++ )
+		llHdl->snapData[llHdl->scanCh[n]] = scan[n];
+
+	llHdl->snapSeq   = hdrP->seq;
+	llHdl->snapStamp = hdrP->stamp;
+	llHdl->snapMask  = hdrP->chMask;
+	llHdl->snapGen   = hdrP->cfgGen;
+
+	M36_MEMBAR();
+	llHdl->snapLock++;			/* even: cache consistent */
+}
+
+/******************************* ScanLatest *********************************
+ *
+ *  Description:  Get a consistent copy of the latest complete scan
+ *
+ *                Reader side of the sequence lock, no bus access.
+ *                Returns ERR_LL_READ if no scan of the current channel
+ *                configuration was published yet.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *  Output.....:  snapP     latest complete scan
+ *                return    success (0) or error code
+ *  Globals....:  ---
+ ****************************************************************************/
+static int32 ScanLatest(	/* nodoc */
+	LL_HANDLE    *llHdl,
+	M36_SNAPSHOT *snapP
+)
+{
+	u_int32 lock, ch;
+
+	do {
+		lock = llHdl->snapLock;
+		M36_MEMBAR();
+
+		snapP->seq    = llHdl->snapSeq;
+		snapP->stamp  = llHdl->snapStamp;
+		snapP->chMask = llHdl->snapMask;
+		snapP->cfgGen = llHdl->snapGen;
+		for( ch=0; ch<CH_NUMBER_SINGLE; ch++ )
+			snapP->data[ch] = llHdl->snapData[ch];
+
+		M36_MEMBAR();
+	} while( (lock & 1) || (lock != llHdl->snapLock) );
+
+	/* nothing published or old configuration ? */
+	if( (lock == 0) || (snapP->cfgGen != llHdl->cfgGen) )
+		return(ERR_LL_READ);
+
+	return(ERR_SUCCESS);
+}
+
+/******************************* DeferDrain *********************************
+ *
+ *  Description:  Bottom half: move scans from deferred ring to input buffer
+ *
+ *                Called from the bottom half timer only: single producer
+ *                (M36_Irq, dfrHead) and single consumer (dfrTail), the
+ *                indices are published with memory barriers, no lock.
+ *                StoreFrame() masks the interrupt only around the input
+ *                buffer bookkeeping (MBUF_GetNextBuf/MBUF_ReadyBuf).
+ *                Scans recorded with a different channel set are dropped
+ *                and counted as M36_STATS.dropped.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  llHdl		ll handle
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void DeferDrain(	/* nodoc */
+	LL_HANDLE *llHdl
+)
+{
+	u_int32 tail = llHdl->dfrTail;
+	u_int16 *slotP;
+
+	while( tail != llHdl->dfrHead ) {
+		M36_MEMBAR();		/* head read before slot */
+
+		slotP = &llHdl->dfrRing[(tail & llHdl->dfrMask) * DFR_SLOT_WORDS];
+
+		if( ((M36_FRAME_HDR*)slotP)->nbrCh == (u_int16)llHdl->scanNbr )
+			StoreFrame( llHdl, slotP, slotP + FRAME_HDR_WORDS, FALSE );
+		else
+			llHdl->statDropped++;	/* only consumer: no race */
+
+		M36_MEMBAR();		/* slot consumed before tail */
+		llHdl->dfrTail = ++tail;
+	}
+}
+
+/******************************* DeferTimer *********************************
+ *
+ *  Description:  Bottom half timer callback
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  arg		ll handle
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void DeferTimer(	/* nodoc */
+	void *arg
+)
+{
+	DeferDrain( (LL_HANDLE*)arg );
+}
+
+/******************************* SwTimer ************************************
+ *
+ *  Description:  Software-timed sampling timer callback (SW_TIMER/PERIOD)
+ *
+ *                Takes one scan of the latest conversion results and
+ *                delivers it like M36_Irq. The interrupt is disabled in
+ *                this mode, masking it serializes against the readers.
+ *
+ *                The module keeps converting, so the data registers are
+ *                only coherent right after a scan completed. The pending
+ *                IRQ bit is reset and the next end of scan is polled
+ *                (max. SW_SYNC_USEC) before the registers are read, like
+ *                M36_Irq does. If the module does not finish a scan in
+ *                time (e.g. external trigger stopped), the tick is
+ *                skipped.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  arg		ll handle
+ *  Output.....:  ---
+ *  Globals....:  ---
+ ****************************************************************************/
+static void SwTimer(	/* nodoc */
+	void *arg
+)
+{
+	LL_HANDLE *llHdl = (LL_HANDLE*)arg;
+	OSS_IRQ_STATE irqState;
+	u_int16 stat;
+	u_int32 usec;
+
+	irqState = OSS_IrqMaskR(llHdl->osHdl, llHdl->irqHdl);
+
+	/* wait for the end of the next scan (IRQ bit low active) */
+	MWRITE_D16(llHdl->ma, CTRL_REG, llHdl->ctrlShadow | RST);
+	for( usec=0; usec<SW_SYNC_USEC; usec++ ) {
+		stat = MREAD_D16(llHdl->ma, STAT_REG);
+		if( !(stat & IRQ) )
+			break;
+		OSS_MikroDelay(llHdl->osHdl, 1);
+	}
+
+	if( usec < SW_SYNC_USEC ) {
+		llHdl->irqStamp = M36_TIMESTAMP( llHdl );
+		ScanStatus( llHdl, stat );
+		DeliverScan( llHdl, NULL );
+	}
+	else {
+		IDBGWRT_ERR((DBH, "*** LL - M36 SwTimer: no end of scan\n"));
+	}
 
+	OSS_IrqRestore(llHdl->osHdl, llHdl->irqHdl, irqState);
 }
 
 /******************************* Calibrate ***********************************
@@ -1818,10 +5561,10 @@ static int32 Calibrate(	/* nodoc */
 
 	/* force internal trigger */
 	if (llHdl->extTrig){
-		MCLRMASK_D16(llHdl->ma, CTRL_REG, EXT);
+		CTRL_WRITE(llHdl, llHdl->ctrlShadow & ~EXT);
 	}
 	/* wait for sample */
-	MSETMASK_D16(llHdl->ma, CTRL_REG, RST);			/* irq reset */
+	MWRITE_D16(llHdl->ma, CTRL_REG, llHdl->ctrlShadow | RST);	/* irq reset */
 	toutLoopCount = 0;
 	do{
 		OSS_Delay( llHdl->osHdl, TOUT_DELAY );
@@ -1830,8 +5573,8 @@ static int32 Calibrate(	/* nodoc */
 			goto ABORT;
 	}while( regVal & IRQ );				/* wait for irq=0 (active) */
 
-	/* calibration mode ON */
-	MSETMASK_D16(llHdl->ma, CTRL_REG, CAL);
+	/* calibration mode ON (CAL is cleared by the hardware) */
+	MWRITE_D16(llHdl->ma, CTRL_REG, llHdl->ctrlShadow | CAL);
 
 	/* wait for calibration started */
 	toutLoopCount = 0;
@@ -1856,7 +5599,7 @@ static int32 Calibrate(	/* nodoc */
 
 	/* restore trigger */
 	if (llHdl->extTrig){
-		MSETMASK_D16(llHdl->ma, CTRL_REG, EXT);
+		CTRL_WRITE(llHdl, llHdl->ctrlShadow | EXT);
 	}
 
 	return(ERR_SUCCESS);
@@ -115,6 +115,8 @@ static void usage(void)
 	printf("                  0 = raw hex value \n");
 	printf("                  1 = volt	\n");
 	printf("                  2 = ampere (only for gain factor x8)\n");
+	printf("    -x=<ch>      read channel ring of ch (DEMUX)      [no]\n");
+	printf("                  (descriptor DEMUX/DEPTH>0 needed)\n");
 	printf("    -h           install buffer highwater signal      [no]\n");
 	printf("    -l           loop mode                            [no]\n");
 	printf("\n");
@@ -135,6 +137,7 @@ int main(int argc, char **argv)
 	MDIS_PATH path=0;
 	int32	firstCh, lastCh, blkmode, blksize, tout;
 	int32	gain, mode, trig, disp, signal, loopmode, n, ch, chNbr, gotsize;
+	int32	demuxCh, level, lost;
 	u_int8	*blkbuf = NULL;
 	u_int8	*bp = NULL;
 	u_int8	*bp0 = NULL;
@@ -145,7 +148,7 @@ int main(int argc, char **argv)
 	/*--------------------+
     |  check arguments    |
     +--------------------*/
-	if ((errstr = UTL_ILLIOPT("a=z=b=s=o=g=m=t=d=hl?", buf))) {	/* check args */
+	if ((errstr = UTL_ILLIOPT("a=z=b=s=o=g=m=t=d=x=hl?", buf))) {	/* check args */
 		printf("*** %s\n", errstr);
 		return(1);
 	}
@@ -178,6 +181,7 @@ int main(int argc, char **argv)
 	mode     = ((str = UTL_TSTOPT("m=")) ? atoi(str) : 0);
 	trig     = ((str = UTL_TSTOPT("t=")) ? atoi(str) : 0);
 	disp     = ((str = UTL_TSTOPT("d=")) ? atoi(str) : 0);
+	demuxCh  = ((str = UTL_TSTOPT("x=")) ? atoi(str) : -1);
 	signal   = (UTL_TSTOPT("h") ? 1 : 0);
 	loopmode = (UTL_TSTOPT("l") ? 1 : 0);
 
@@ -290,6 +294,14 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (demuxCh != -1) {
+		/* channel ring of the current channel */
+		if ((M_setstat(path, M_MK_CH_CURRENT, demuxCh)) < 0) {
+			PrintMdisError("setstat M_MK_CH_CURRENT");
+			goto abort;
+		}
+	}
+
 	if (signal) {
 		/* enable buffer highwater signal */
 		if ((M_setstat(path, M_BUF_RD_SIGSET_HIGH, UOS_SIG_USR1)) < 0) {
@@ -320,13 +332,15 @@ int main(int argc, char **argv)
 	printf("gain factor         : %d\n", 1 << gain);
 	printf("measuring mode      : %s\n",(mode==0 ? "unipolar":"bipolar"));
 	printf("trigger mode        : %s\n",(trig==0 ? "intern":"extern"));
+	if (demuxCh != -1)
+		printf("channel ring        : %d\n", (int)demuxCh);
 	printf("buf highwater signal: %s\n",(signal==0 ? "no":"yes"));
 	printf("loop mode           : %s\n\n",(loopmode==0 ? "no":"yes"));
 
     /*--------------------+
     |  enable interrupt   |
     +--------------------*/
-	if (blkmode)
+	if (blkmode || (demuxCh != -1))
 		/* enable interrupt */
 		if ((M_setstat(path, M_MK_IRQ_ENABLE, 1)) < 0) {
 					PrintMdisError("setstat M_MK_IRQ_ENABLE");
@@ -344,6 +358,17 @@ int main(int argc, char **argv)
 			break;
 		}
 
+		/* channel ring: samples of one channel */
+		if (demuxCh != -1) {
+			if ((M_getstat(path, M36_DEMUX_LEVEL, &level) < 0) ||
+				(M_getstat(path, M36_DEMUX_LOST, &lost) < 0)) {
+				PrintMdisError("getstat M36_DEMUX_LEVEL/LOST");
+				break;
+			}
+			printf("channel %d: %d samples, %d still in ring, %d lost\n",
+				   (int)demuxCh, (int)(gotsize / 2), (int)level, (int)lost);
+		}
+
 		/* raw hex value */
 		if (disp == 0) {
 				UTL_Memdump("raw hex value:",(char*)blkbuf,gotsize,2);
@@ -392,7 +417,7 @@ int main(int argc, char **argv)
     |  cleanup            |
     +--------------------*/
 	abort:
-	if (blkmode)
+	if (blkmode || (demuxCh != -1))
 		/* disable interrupt */
 		if ((M_setstat(path, M_MK_IRQ_ENABLE, 0)) < 0) {
 				PrintMdisError("setstat M_MK_IRQ_ENABLE");
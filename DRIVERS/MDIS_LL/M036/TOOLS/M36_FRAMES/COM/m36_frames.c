@@ -0,0 +1,578 @@
+/****************************************************************************
+ ************                                                    ************
+ ************               M 3 6 _ F R A M E S                  ************
+ ************                                                    ************
+ ****************************************************************************
+ *
+ *  Description: Read and decode M36 scan frames (frame header modes)
+ *
+ *               Reads the scans stored with frame header from the
+ *               storage configured in the descriptor (detected at start):
+ *               - input buffer      (IN_BUF/FRAME_HEADER=1)
+ *               - driver scan ring  (SCAN_RING/DEPTH>0)
+ *               - buffer queue      (BUF_QUEUE/NUM>0)
+ *               either with M_getblock or with the deadline bounded read
+ *               (M36_BLK_READ), and prints sequence number, timestamp,
+ *               flags and samples of each scan. Gaps in the sequence
+ *               number are reported (lost scans, scans outside trigger
+ *               or gate windows).
+ *
+ *               Finite acquisition (M36_ACQ_COUNT), software trigger
+ *               (M36_TRG_xxx), gating (M36_GATE_MODE), BIN sampling
+ *               (M36_BIN_SAMPLE) and software-timed sampling
+ *               (M36_SW_PERIOD) can be set up via options.
+ *
+ *     Required: usr_oss.l usr_utl.l
+ *     Switches: -
+ *
+ *---------------------------------------------------------------------------
+ * (c) Copyright 2026 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/usr_oss.h>
+#include <MEN/usr_utl.h>
+#include <MEN/mdis_api.h>
+#include <MEN/m36_drv.h>
+
+/*--------------------------------------+
+|   DEFINES                             |
++--------------------------------------*/
+/* storage of the scans */
+#define STORE_INBUF		0		/* input buffer */
+#define STORE_RING		1		/* driver scan ring */
+#define STORE_BUFQ		2		/* buffer queue */
+
+/*--------------------------------------+
+|   GLOBALS                             |
++--------------------------------------*/
+static volatile int32 G_acqDone;		/* finite acquisition complete */
+static int32  G_first = 1;				/* no scan printed yet */
+static u_int32 G_nextSeq;				/* expected sequence number */
+
+/*--------------------------------------+
+|   PROTOTYPES                          |
++--------------------------------------*/
+static void usage(void);
+static int32 PrintFrames(u_int8 *data, int32 size, int32 frameSize);
+static void PrintInfo(MDIS_PATH path, int32 store);
+static void PrintMdisError(char *info);
+static void PrintUosError(char *info);
+static void __MAPILIB SigHandler(u_int32 sigCode);
+
+/********************************* usage ************************************
+ *
+ *  Description: Print program usage
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: -
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void usage(void)
+{
+	printf("Usage: m36_frames [<opts>] <device> [<opts>]\n");
+	printf("Function: Read and decode M36 scan frames (frame header modes)\n");
+	printf("Options:\n");
+	printf("    device       device name                          [none]\n");
+	printf("    -c=<cur>     read cursor (scan ring only)         [0]\n");
+	printf("    -s=<size>    block size in bytes                  [1024]\n");
+	printf("    -w=<n>       scans to wait for (scan ring only)   [descr.]\n");
+	printf("    -e=<msec>    deadline bounded read (M36_BLK_READ) [off]\n");
+	printf("    -n=<n>       scans for deadline read (0=fit)      [0]\n");
+	printf("    -a=<n>       finite acquisition of n scans        [off]\n");
+	printf("    -p=<msec>    software-timed sampling period       [irq]\n");
+	printf("                  (descriptor SW_TIMER/PERIOD>0 needed)\n");
+	printf("    -g=<mode>    gate mode                            [descr.]\n");
+	printf("                  0 = off\n");
+	printf("                  1 = store scans while BIN=1\n");
+	printf("                  2 = store scans while BIN=0\n");
+	printf("    -b           store BIN in frame header flags      [no]\n");
+	printf("    -t=<ch>      software trigger channel             [descr.]\n");
+	printf("    -v=<level>   software trigger level (raw)         [descr.]\n");
+	printf("    -k=<edge>    software trigger condition           [descr.]\n");
+	printf("                  0 = rising, 1 = falling\n");
+	printf("                  2 = above,  3 = below\n");
+	printf("                  (descriptor TRIGGER/ENABLE=1 needed)\n");
+	printf("    -i           print state/statistics at the end    [no]\n");
+	printf("    -l           loop mode                            [no]\n");
+	printf("\n");
+	printf("Frame flags: G = first scan of a gate window, B = BIN was 1\n");
+	printf("\n");
+	printf("(c) 2026 by MEN mikro elektronik GmbH\n\n");
+}
+
+/********************************* main *************************************
+ *
+ *  Description: Program main function
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: argc,argv	argument counter, data ..
+ *  Output.....: return	    success (0) or error (1)
+ *  Globals....: -
+ ****************************************************************************/
+int main(int argc, char **argv)
+{
+	MDIS_PATH path=0;
+	int32	cursor, blksize, wait, deadline, dlScans, acqCount, swPeriod;
+	int32	gate, binSample, trgCh, trgLevel, trgEdge, info, loopmode;
+	int32	store, frameSize, gotsize, nbrScans, signal, n;
+	u_int8	*blkbuf = NULL;
+	u_int8	*data;
+	char	*device,*str,*errstr,buf[40];
+	M_SG_BLOCK		blk;
+	M36_RING_INFO	ringInfo;
+	M36_BUFQ_INFO	bufqInfo;
+	M36_DLREAD_HDR	*dlP;
+	M36_BUFQ_HDR	bufqHdr;
+
+	/*--------------------+
+    |  check arguments    |
+    +--------------------*/
+	if ((errstr = UTL_ILLIOPT("c=s=w=e=n=a=p=g=bt=v=k=il?", buf))) {
+		printf("*** %s\n", errstr);
+		return(1);
+	}
+
+	if (UTL_TSTOPT("?")) {						/* help requested ? */
+		usage();
+		return(1);
+	}
+
+	/*--------------------+
+    |  get arguments      |
+    +--------------------*/
+	for (device=NULL, n=1; n<argc; n++)
+		if (*argv[n] != '-') {
+			device = argv[n];
+			break;
+		}
+
+	if (!device) {
+		usage();
+		return(1);
+	}
+
+	cursor    = ((str = UTL_TSTOPT("c=")) ? atoi(str) : 0);
+	blksize   = ((str = UTL_TSTOPT("s=")) ? atoi(str) : 1024);
+	wait      = ((str = UTL_TSTOPT("w=")) ? atoi(str) : -1);
+	deadline  = ((str = UTL_TSTOPT("e=")) ? atoi(str) : 0);
+	dlScans   = ((str = UTL_TSTOPT("n=")) ? atoi(str) : 0);
+	acqCount  = ((str = UTL_TSTOPT("a=")) ? atoi(str) : 0);
+	swPeriod  = ((str = UTL_TSTOPT("p=")) ? atoi(str) : 0);
+	gate      = ((str = UTL_TSTOPT("g=")) ? atoi(str) : -1);
+	binSample = (UTL_TSTOPT("b") ? 1 : 0);
+	trgCh     = ((str = UTL_TSTOPT("t=")) ? atoi(str) : -1);
+	trgLevel  = ((str = UTL_TSTOPT("v=")) ? strtol(str, NULL, 0) : -1);
+	trgEdge   = ((str = UTL_TSTOPT("k=")) ? atoi(str) : -1);
+	info      = (UTL_TSTOPT("i") ? 1 : 0);
+	loopmode  = (UTL_TSTOPT("l") ? 1 : 0);
+	signal    = (acqCount ? 1 : 0);
+
+	/*--------------------+
+    |  create buffer      |
+    +--------------------*/
+	/* deadline read: header followed by the data */
+	if ((blkbuf = (u_int8*)malloc(sizeof(M36_DLREAD_HDR) + blksize)) == NULL) {
+		printf("*** can't alloc %d bytes\n",(int)blksize);
+		return(1);
+	}
+
+	if (signal) {
+		/*--------------------+
+		|  install signal     |
+		+--------------------*/
+		/* install signal handler */
+		if (UOS_SigInit(SigHandler)) {
+			PrintUosError("SigInit");
+			return(1);
+		}
+		/* install signal */
+		if (UOS_SigInstall(UOS_SIG_USR1)) {
+			PrintUosError("SigInstall");
+			goto abort;
+		}
+	}
+
+	/*--------------------+
+    |  open path          |
+    +--------------------*/
+	if ((path = M_open(device)) < 0) {
+		PrintMdisError("open");
+		return(1);
+	}
+
+	/*--------------------+
+    |  detect storage     |
+    +--------------------*/
+	/* read cursor of the scan ring is selected by the current channel */
+	if ((M_setstat(path, M_MK_CH_CURRENT, cursor)) < 0) {
+		PrintMdisError("setstat M_MK_CH_CURRENT");
+		goto abort;
+	}
+
+	blk.size = sizeof(ringInfo);
+	blk.data = (void*)&ringInfo;
+
+	if (M_getstat(path, M36_BLK_RING, (int32*)&blk) == 0) {
+		store     = STORE_RING;
+		frameSize = ringInfo.slotSize;
+	}
+	else {
+		blk.size = sizeof(bufqInfo);
+		blk.data = (void*)&bufqInfo;
+
+		if ((M_getstat(path, M36_BLK_BUFQ, (int32*)&blk)) < 0) {
+			PrintMdisError("getstat M36_BLK_BUFQ");
+			goto abort;
+		}
+		store = (bufqInfo.num ? STORE_BUFQ : STORE_INBUF);
+
+		if ((M_getstat(path, M36_FRAME_SIZE, &frameSize)) < 0) {
+			PrintMdisError("getstat M36_FRAME_SIZE");
+			goto abort;
+		}
+	}
+
+	/*--------------------+
+    |  config             |
+    +--------------------*/
+	/* input buffer: wait for data */
+	if (store == STORE_INBUF) {
+		if ((M_setstat(path, M_BUF_RD_MODE, M_BUF_RINGBUF)) < 0) {
+			PrintMdisError("setstat M_BUF_RD_MODE");
+			goto abort;
+		}
+	}
+	/* scans to wait for */
+	if (wait != -1) {
+		if ((M_setstat(path, M36_RING_WAIT, wait)) < 0) {
+			PrintMdisError("setstat M36_RING_WAIT");
+			goto abort;
+		}
+	}
+	/* gating */
+	if (gate != -1) {
+		if ((M_setstat(path, M36_GATE_MODE, gate)) < 0) {
+			PrintMdisError("setstat M36_GATE_MODE");
+			goto abort;
+		}
+	}
+	/* BIN in frame header */
+	if (binSample) {
+		if ((M_setstat(path, M36_BIN_SAMPLE, 1)) < 0) {
+			PrintMdisError("setstat M36_BIN_SAMPLE");
+			goto abort;
+		}
+	}
+	/* software trigger */
+	if (trgCh != -1) {
+		if ((M_setstat(path, M36_TRG_CH, trgCh)) < 0) {
+			PrintMdisError("setstat M36_TRG_CH");
+			goto abort;
+		}
+	}
+	if (trgLevel != -1) {
+		if ((M_setstat(path, M36_TRG_LEVEL, trgLevel)) < 0) {
+			PrintMdisError("setstat M36_TRG_LEVEL");
+			goto abort;
+		}
+	}
+	if (trgEdge != -1) {
+		if ((M_setstat(path, M36_TRG_EDGE, trgEdge)) < 0) {
+			PrintMdisError("setstat M36_TRG_EDGE");
+			goto abort;
+		}
+	}
+	if (signal) {
+		/* enable acquisition complete signal */
+		if ((M_setstat(path, M36_ACQ_SIGSET, UOS_SIG_USR1)) < 0) {
+			PrintMdisError("setstat M36_ACQ_SIGSET");
+			goto abort;
+		}
+	}
+
+    /*--------------------+
+    |  print info         |
+    +--------------------*/
+	printf("storage             : %s\n",
+		   (store == STORE_RING ? "scan ring" :
+			(store == STORE_BUFQ ? "buffer queue" : "input buffer")));
+	printf("frame size          : %d bytes\n", frameSize);
+	printf("block size          : %d bytes\n", blksize);
+	if (store == STORE_RING)
+		printf("read cursor         : %d\n", cursor);
+	if (deadline)
+		printf("deadline read       : %d msec, %d scans\n",
+			   deadline, dlScans);
+	if (acqCount)
+		printf("finite acquisition  : %d scans\n", acqCount);
+	printf("sampling            : %s\n", (swPeriod ? "timer" : "interrupt"));
+	printf("loop mode           : %s\n\n",(loopmode==0 ? "no":"yes"));
+
+    /*--------------------+
+    |  start sampling     |
+    +--------------------*/
+	if (swPeriod) {
+		/* software-timed sampling */
+		if ((M_setstat(path, M36_SW_PERIOD, swPeriod)) < 0) {
+			PrintMdisError("setstat M36_SW_PERIOD");
+			goto abort;
+		}
+	}
+	else {
+		/* enable interrupt */
+		if ((M_setstat(path, M_MK_IRQ_ENABLE, 1)) < 0) {
+			PrintMdisError("setstat M_MK_IRQ_ENABLE");
+			goto abort;
+		}
+	}
+	/* arm finite acquisition */
+	if (acqCount) {
+		if ((M_setstat(path, M36_ACQ_COUNT, acqCount)) < 0) {
+			PrintMdisError("setstat M36_ACQ_COUNT");
+			goto abort;
+		}
+	}
+
+    /*--------------------+
+    |  read frames        |
+    +--------------------*/
+	do {
+		/* deadline bounded read */
+		if (deadline) {
+			dlP = (M36_DLREAD_HDR*)blkbuf;
+			dlP->deadline = deadline;
+			dlP->nbrScans = dlScans;
+			blk.size = sizeof(M36_DLREAD_HDR) + blksize;
+			blk.data = (void*)blkbuf;
+
+			if ((M_getstat(path, M36_BLK_READ, (int32*)&blk)) < 0) {
+				PrintMdisError("getstat M36_BLK_READ");
+				break;
+			}
+			data    = blkbuf + sizeof(M36_DLREAD_HDR);
+			gotsize = dlP->size;
+			printf("deadline read: %d scans\n", (int32)dlP->nbrScans);
+		}
+		/* block read */
+		else {
+			if ((gotsize = M_getblock(path, blkbuf, blksize)) < 0) {
+				PrintMdisError("getblock");
+				break;
+			}
+			data = blkbuf;
+
+			/* buffer queue: buffer header first */
+			if (store == STORE_BUFQ) {
+				memcpy(&bufqHdr, data, sizeof(bufqHdr));
+				printf("buffer: %d scans, first seq %u\n",
+					   (int32)bufqHdr.nbrScans, bufqHdr.firstSeq);
+				data    += sizeof(bufqHdr);
+				gotsize  = bufqHdr.size;
+			}
+		}
+
+		if ((nbrScans = PrintFrames(data, gotsize, frameSize)) < 0)
+			break;
+
+	} while((loopmode || (acqCount && !(G_acqDone && nbrScans == 0))) &&
+			UOS_KeyPressed() == -1);
+
+	if (info)
+		PrintInfo(path, store);
+
+	/*--------------------+
+    |  cleanup            |
+    +--------------------*/
+	abort:
+	if (swPeriod) {
+		/* stop timer */
+		if ((M_setstat(path, M36_SW_PERIOD, 0)) < 0)
+			PrintMdisError("setstat M36_SW_PERIOD");
+	}
+	else {
+		/* disable interrupt */
+		if ((M_setstat(path, M_MK_IRQ_ENABLE, 0)) < 0)
+			PrintMdisError("setstat M_MK_IRQ_ENABLE");
+	}
+
+	if (signal) {
+		M_setstat(path, M36_ACQ_SIGCLR, 0);
+		/* terminate signal handling */
+		UOS_SigExit();
+	}
+
+	if (M_close(path) < 0)
+		PrintMdisError("close");
+
+	free(blkbuf);
+
+	return(0);
+}
+
+/********************************* PrintFrames ******************************
+ *
+ *  Description: Decode and print the frames of a data block
+ *
+ *               Frames in the input buffer may start at any even address,
+ *               so the header is copied before it is decoded.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: data		frames
+ *               size		size of frames [bytes]
+ *               frameSize	size of one frame/slot [bytes]
+ *  Output.....: return		nbr of scans or -1 (no frame header)
+ *  Globals....: G_first, G_nextSeq
+ ****************************************************************************/
+static int32 PrintFrames(u_int8 *data, int32 size, int32 frameSize)
+{
+	M36_FRAME_HDR hdr;
+	u_int16 sample;
+	int32 off, n, nbrScans = 0;
+
+	for (off=0; off + frameSize <= size; off += frameSize, nbrScans++) {
+		memcpy(&hdr, data + off, sizeof(hdr));
+
+		if (hdr.hdrSize != sizeof(M36_FRAME_HDR)) {
+			printf("*** no frame header (IN_BUF/FRAME_HEADER=1 needed)\n");
+			return(-1);
+		}
+
+		/* sequence gap: lost or not stored scans */
+		if (!G_first && (hdr.seq != G_nextSeq))
+			printf("--- %u scans lost or outside trigger/gate window\n",
+				   hdr.seq - G_nextSeq);
+		G_first   = 0;
+		G_nextSeq = hdr.seq + 1;
+
+		printf("seq=%8u stamp=%10u gen=%3d mask=0x%04x %c%c :",
+			   hdr.seq, hdr.stamp, hdr.cfgGen, hdr.chMask,
+			   (hdr.flags & M36_HDR_GATE_START) ? 'G' : '-',
+			   (hdr.flags & M36_HDR_BIN) ? 'B' : '-');
+
+		for (n=0; n<hdr.nbrCh; n++) {
+			memcpy(&sample, data + off + hdr.hdrSize + n * 2, 2);
+			printf(" %04x", sample);
+		}
+		printf("\n");
+	}
+
+	return(nbrScans);
+}
+
+/********************************* PrintInfo ********************************
+ *
+ *  Description: Print state of storage, trigger, gate and statistics
+ *
+ *               Status codes of modes which are not configured fail and
+ *               are skipped.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: path	path number
+ *               store	storage of the scans
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void PrintInfo(MDIS_PATH path, int32 store)
+{
+	M_SG_BLOCK		blk;
+	M36_STATS		stats;
+	M36_RING_INFO	ringInfo;
+	M36_BUFQ_INFO	bufqInfo;
+	int32			value;
+
+	printf("\n");
+
+	blk.size = sizeof(stats);
+	blk.data = (void*)&stats;
+	if (M_getstat(path, M36_BLK_STATS, (int32*)&blk) == 0) {
+		printf("interrupts          : %u\n", stats.irqs);
+		printf("scans stored        : %u\n", stats.scans);
+		printf("scans dropped       : %u\n", stats.dropped);
+		printf("deferred ring lost  : %u\n", stats.dfrLost);
+		printf("max. irq duration   : %u\n", stats.irqTimeMax);
+	}
+
+	if (store == STORE_RING) {
+		blk.size = sizeof(ringInfo);
+		blk.data = (void*)&ringInfo;
+		if (M_getstat(path, M36_BLK_RING, (int32*)&blk) == 0) {
+			printf("ring depth          : %u slots\n", ringInfo.depth);
+			printf("ring level          : %u slots (max. %u)\n",
+				   ringInfo.head - ringInfo.tail, ringInfo.highwater);
+			printf("ring lost           : %u scans\n", ringInfo.lost);
+		}
+	}
+
+	if (store == STORE_BUFQ) {
+		blk.size = sizeof(bufqInfo);
+		blk.data = (void*)&bufqInfo;
+		if (M_getstat(path, M36_BLK_BUFQ, (int32*)&blk) == 0) {
+			printf("buffers             : %u x %u bytes\n",
+				   bufqInfo.num, bufqInfo.size);
+			printf("buffers done        : %u\n", bufqInfo.done);
+			printf("buffer queue lost   : %u scans\n", bufqInfo.lost);
+		}
+	}
+
+	if (M_getstat(path, M36_ACQ_LEFT, &value) == 0)
+		printf("scans left          : %d\n", value);
+	if (M_getstat(path, M36_TRG_WINDOWS, &value) == 0)
+		printf("trigger windows     : %d\n", value);
+	if (M_getstat(path, M36_GATE_EDGES, &value) == 0)
+		printf("gate edges          : %d\n", value);
+}
+
+/********************************* PrintMdisError ***************************
+ *
+ *  Description: Print MDIS error message
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: info	info string
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void PrintMdisError(char *info)
+{
+	printf("*** can't %s: %s\n", info, M_errstring(UOS_ErrnoGet()));
+}
+
+/********************************* PrintUosError ****************************
+ *
+ *  Description: Print UOS error message
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: info	info string
+ *  Output.....: -
+ *  Globals....: -
+ ****************************************************************************/
+static void PrintUosError(char *info)
+{
+	printf("*** can't %s: %s\n", info, UOS_ErrString(UOS_ErrnoGet()));
+}
+
+/********************************* SigHandler *******************************
+ *
+ *  Description: Signal handler
+ *
+ *---------------------------------------------------------------------------
+ *  Input......: sigCode	signal code received
+ *  Output.....: -
+ *  Globals....: G_acqDone
+ ****************************************************************************/
+static void __MAPILIB SigHandler(u_int32 sigCode)
+{
+	switch(sigCode) {
+		case UOS_SIG_USR1:
+			printf(">>> Acquisition complete\n");
+			G_acqDone = 1;
+			break;
+		default:
+			printf(">>> signal=%d received\n",sigCode);
+	}
+}
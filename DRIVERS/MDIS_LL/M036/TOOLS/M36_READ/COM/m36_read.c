@@ -97,6 +97,9 @@ static void usage(void)
 	printf("                  0 = raw hex value \n");
 	printf("                  1 = hex and volt	\n");
 	printf("                  2 = hex and ampere (only for gain factor x8)\n");
+	printf("    -s           snapshot of all channels    [no]\n");
+	printf("                  (M36_BLK_SNAPSHOT, latest scan of the\n");
+	printf("                   interrupt or sampling timer if running)\n");
 	printf("    -l           loop mode                   [no]\n");
 	printf("\n");
 	printf("(c) 1998 by MEN mikro elektronik GmbH\n\n");
@@ -114,14 +117,16 @@ static void usage(void)
 int main(int argc, char **argv)
 {
 	MDIS_PATH path=0;
-	int32	chan, gain, mode, disp, loopmode, value, trig, n, gainfac;
+	int32	chan, gain, mode, disp, loopmode, value, trig, n, gainfac, snap;
 	char	*device, *str, *errstr, buf[40];
 	double	volt, curr;
+	M_SG_BLOCK   blk;
+	M36_SNAPSHOT snapshot;
 
 	/*--------------------+
     |  check arguments    |
     +--------------------*/
-	if ((errstr = UTL_ILLIOPT("c=g=m=t=d=l?", buf))) {	/* check args */
+	if ((errstr = UTL_ILLIOPT("c=g=m=t=d=sl?", buf))) {	/* check args */
 		printf("*** %s\n", errstr);
 		return(1);
 	}
@@ -150,6 +155,7 @@ int main(int argc, char **argv)
 	mode     = ((str = UTL_TSTOPT("m=")) ? atoi(str) : 0);
 	trig     = ((str = UTL_TSTOPT("t=")) ? atoi(str) : 0);
 	disp     = ((str = UTL_TSTOPT("d=")) ? atoi(str) : 0);
+	snap     = (UTL_TSTOPT("s") ? 1 : 0);
 	loopmode = (UTL_TSTOPT("l") ? 1 : 0);
 
 	/* check for option conflict */
@@ -213,6 +219,26 @@ int main(int argc, char **argv)
     |  read               |
     +--------------------*/
 	do {
+		/* latest complete scan of all enabled channels */
+		if (snap) {
+			blk.size = sizeof(snapshot);
+			blk.data = (void*)&snapshot;
+			if ((M_getstat(path, M36_BLK_SNAPSHOT, (int32*)&blk)) < 0) {
+				PrintError("getstat M36_BLK_SNAPSHOT");
+				goto abort;
+			}
+			/* seq=0: no acquisition, data registers were read */
+			printf("snapshot: seq=%u stamp=%u gen=%d:",
+				   snapshot.seq, snapshot.stamp, snapshot.cfgGen);
+			for (n=0; n<16; n++)
+				if (snapshot.chMask & (1 << n))
+					printf(" %d=0x%04x", n, snapshot.data[n]);
+			printf("\n");
+
+			UOS_Delay(100);
+			continue;
+		}
+
 		if ((M_read(path,&value)) < 0) {
 			PrintError("read");
 			goto abort;
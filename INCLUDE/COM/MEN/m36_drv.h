@@ -44,7 +44,103 @@
 /*-----------------------------------------+
 |  TYPEDEFS                                |
 +-----------------------------------------*/
-/* none */
+/* frame header in the input buffer (IN_BUF/FRAME_HEADER=1) */
+typedef struct {
+	u_int32 seq;			/* scan sequence number (gap = lost scans) */
+	u_int32 stamp;			/* timestamp (OSS ticks or CPU cycles) */
+	u_int16 chMask;			/* enabled channels (bit n = channel n) */
+	u_int16 cfgGen;			/* channel configuration generation */
+	u_int16 nbrCh;			/* nbr of samples following the header */
+	u_int16 hdrSize;		/* header size [bytes] */
+	u_int16 flags;			/* scan flags (M36_HDR_xxx) */
+	u_int16 rsvd;			/* reserved (0) */
+} M36_FRAME_HDR;
+
+/* M36_FRAME_HDR flags */
+#define M36_HDR_GATE_START	0x0001	/* first scan of a gate window */
+#define M36_HDR_BIN			0x0002	/* binary input was 1 (BIN_SAMPLE) */
+
+/* M36_BLK_IRQMOD: adaptive irq moderation state */
+typedef struct {
+	u_int32 mode;			/* 0=off, 1=adaptive */
+	u_int32 batch;			/* current scans per interrupt */
+	u_int32 rateHigh;		/* switch to batched mode above [scans/s] */
+	u_int32 rateLow;		/* switch to single scan mode below [scans/s] */
+	u_int32 toBatch;		/* nbr of switches to batched mode */
+	u_int32 toSingle;		/* nbr of switches to single scan mode */
+	u_int32 ticksSingle;	/* time in single scan mode [ticks] */
+	u_int32 ticksBatch;		/* time in batched mode [ticks] */
+	u_int32 tickRate;		/* ticks per second */
+	u_int32 batchMax;		/* max. scans per interrupt (1=no batching) */
+} M36_IRQMOD;
+
+/* M36_BLK_STATS: acquisition statistics */
+typedef struct {
+	u_int32 irqs;			/* interrupts handled */
+	u_int32 scans;			/* scans stored into input buffer */
+	u_int32 dropped;		/* scans lost, input buffer full or
+							   channel set changed (IRQ_DEFER) */
+	u_int32 wrapFail;		/* frames truncated at buffer wrap around */
+	u_int32 dfrLost;		/* scans lost, deferred ring full */
+	u_int32 levelMax;		/* input buffer fill high-watermark [bytes] */
+	u_int32 irqTimeMax;		/* longest irq duration (timestamp units) */
+} M36_STATS;
+
+/* M36_BLK_CONFIG: channel configuration */
+typedef struct {
+	u_int32 enableMask;		/* enabled channels (bit n = channel n) */
+	u_int32 gain[16];		/* gain factor per channel (0..4) */
+	u_int32 bipolar;		/* measuring mode (0=unipolar, 1=bipolar) */
+	u_int32 extTrig;		/* sampling mode (0=internal, 1=external) */
+} M36_CONFIG;
+
+/* M36_BLK_SNAPSHOT: latest complete scan */
+typedef struct {
+	u_int32 seq;			/* scan sequence number */
+	u_int32 stamp;			/* timestamp (OSS ticks or CPU cycles) */
+	u_int16 chMask;			/* valid channels (bit n = channel n) */
+	u_int16 cfgGen;			/* channel configuration generation */
+	u_int16 data[16];		/* sample of channel n */
+} M36_SNAPSHOT;
+
+/* M36_BLK_RING: driver scan ring state (SCAN_RING), read cursor of ch */
+typedef struct {
+	u_int32 depth;			/* nbr of slots */
+	u_int32 slotSize;		/* slot size [bytes] (header + 16 samples) */
+	u_int32 head;			/* slots written (free running) */
+	u_int32 tail;			/* slots read by cursor (free running) */
+	u_int32 lost;			/* scans lost by cursor (full/overwritten) */
+	u_int32 wait;			/* scans M36_BlockRead waits for */
+	u_int32 readers;		/* nbr of read cursors */
+	u_int32 highwater;		/* max. fill level of cursor [slots] */
+	u_int32 batch;			/* current wakeup batch of cursor [scans] */
+} M36_RING_INFO;
+
+/* buffer queue: header of a dequeued buffer (BUF_QUEUE) */
+typedef struct {
+	u_int32 size;			/* size of frames following [bytes] */
+	u_int32 nbrScans;		/* nbr of frames */
+	u_int32 firstSeq;		/* sequence number of first scan */
+	u_int32 firstStamp;		/* timestamp of first scan */
+} M36_BUFQ_HDR;
+
+/* M36_BLK_READ: deadline bounded read, header followed by the data
+   (frames of the input buffer or slots of the scan ring) */
+typedef struct {
+	u_int32 deadline;		/* in : max. wait [msec] (>0) */
+	u_int32 nbrScans;		/* in : scans to wait for (0=as many as fit) */
+							/* out: nbr of scans returned */
+	u_int32 size;			/* out: size of data following [bytes] */
+	u_int32 rsvd;			/* reserved */
+} M36_DLREAD_HDR;
+
+/* M36_BLK_BUFQ: buffer queue state */
+typedef struct {
+	u_int32 num;			/* nbr of buffers */
+	u_int32 size;			/* data size per buffer [bytes] */
+	u_int32 done;			/* completed buffers not yet dequeued */
+	u_int32 lost;			/* scans lost, no free buffer */
+} M36_BUFQ_INFO;
 
 /*-----------------------------------------+
 |  DEFINES                                 |
@@ -63,9 +159,49 @@
 #define M36_FLASH_ERASE		M_DEV_OF+0x08    /*   S: Erase Stratix Flash  */
 #define M36_REG_DUMP		M_DEV_OF+0x09    /* G  : helper, dump Reg space */
 #define M36_GET_RAWDAT		M_DEV_OF+0x0a    /* G  : get raw 18bit of chan ch */
+#define M36_FRAME_SIZE		M_DEV_OF+0x0b    /* G  : scan size in buffer [byte]*/
+#define M36_IRQ_MOD			M_DEV_OF+0x0c    /* G,S: adaptive irq moderation */
+#define M36_IRQ_BATCH		M_DEV_OF+0x0d    /* G  : scans per interrupt */
+#define M36_CFG_STAGE		M_DEV_OF+0x0e    /* G,S: staged channel config */
+#define M36_CFG_COMMIT		M_DEV_OF+0x0f    /* G,S: commit staged config */
+#define M36_CFG_GEN			M_DEV_OF+0x10    /* G  : config generation */
+#define M36_RING_WAIT		M_DEV_OF+0x11    /* G,S: scans to wait for */
+#define M36_DEMUX_LEVEL		M_DEV_OF+0x12    /* G  : samples in channel ring */
+#define M36_DEMUX_LOST		M_DEV_OF+0x13    /* G  : samples lost of channel */
+#define M36_ACQ_COUNT		M_DEV_OF+0x14    /* G,S: finite acquisition */
+#define M36_ACQ_LEFT		M_DEV_OF+0x15    /* G  : scans still to acquire */
+#define M36_ACQ_SIGSET		M_DEV_OF+0x16    /*   S: install completion sig */
+#define M36_ACQ_SIGCLR		M_DEV_OF+0x17    /*   S: remove completion sig */
+#define M36_TRG_CH			M_DEV_OF+0x18    /* G,S: trigger channel */
+#define M36_TRG_LEVEL		M_DEV_OF+0x19    /* G,S: trigger level (raw) */
+#define M36_TRG_EDGE		M_DEV_OF+0x1a    /* G,S: trigger condition */
+#define M36_TRG_WINDOWS		M_DEV_OF+0x1b    /* G  : capture windows stored */
+#define M36_GATE_MODE		M_DEV_OF+0x1c    /* G,S: gating by binary input */
+#define M36_GATE_OPEN		M_DEV_OF+0x1d    /* G  : gate currently open */
+#define M36_GATE_EDGES		M_DEV_OF+0x1e    /* G  : gate edges seen */
+#define M36_BIN_SAMPLE		M_DEV_OF+0x1f    /* G,S: BIN into frame header */
+#define M36_SW_PERIOD		M_DEV_OF+0x20    /* G,S: sw-timed period [ms] */
 
 /* M36 specific status codes (BLK)*/        /* S,G: S=setstat, G=getstat */
 #define M36_BLK_FLASH    M_DEV_BLK_OF+0x00 	/* G,S: Write/Read calib. Data */
+#define M36_BLK_IRQMOD   M_DEV_BLK_OF+0x01 	/* G  : irq moderation state */
+#define M36_BLK_STATS    M_DEV_BLK_OF+0x02 	/* G  : acquisition statistics */
+#define M36_BLK_CONFIG   M_DEV_BLK_OF+0x03 	/* G,S: channel configuration */
+#define M36_BLK_SNAPSHOT M_DEV_BLK_OF+0x04 	/* G  : latest complete scan */
+#define M36_BLK_RING     M_DEV_BLK_OF+0x05 	/* G  : scan ring state */
+#define M36_BLK_BUFQ     M_DEV_BLK_OF+0x06 	/* G  : buffer queue state */
+#define M36_BLK_READ     M_DEV_BLK_OF+0x07 	/* G  : deadline bounded read */
+
+/* software trigger conditions (TRIGGER/EDGE, M36_TRG_EDGE) */
+#define M36_TRG_RISING		0	/* rising edge through level */
+#define M36_TRG_FALLING		1	/* falling edge through level */
+#define M36_TRG_ABOVE		2	/* sample >= level */
+#define M36_TRG_BELOW		3	/* sample <= level */
+
+/* gate modes (GATE/MODE, M36_GATE_MODE) */
+#define M36_GATE_OFF		0	/* no gating */
+#define M36_GATE_HIGH		1	/* store scans while BIN=1 */
+#define M36_GATE_LOW		2	/* store scans while BIN=0 */
 
 
 